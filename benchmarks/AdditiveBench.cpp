@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Compares the reading of tables with the hybrid oscillator, which
+// synthesizes the highest ranges additively, on high notes; the label gives
+// the crossover which the calibration measured, and the memory of the
+// tables which the hybrid multisample keeps.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+#include "sfizz/WavetableAdditive.h"
+#include <cstdio>
+
+using sfz::WavetableHybrid;
+using sfz::WavetableHybridOscillator;
+using sfz::WavetableMulti;
+using sfz::WavetableOscillator;
+
+static constexpr unsigned tableSize = 2048;
+static constexpr unsigned blockSize = 256;
+static constexpr unsigned numBlocks = 64;
+
+static void TableHighNotes(bench::State& state)
+{
+    const float frequency = static_cast<float>(state.arg());
+    const WavetableMulti wm = WavetableMulti::createForHarmonicProfile(
+        bench::SawtoothProfile(), 1.0, tableSize);
+
+    WavetableOscillator osc;
+    osc.init(bench::sampleRate);
+    osc.setWavetable(&wm);
+
+    std::vector<float> output(blockSize);
+    while (state.keepRunning()) {
+        for (unsigned b = 0; b < numBlocks; ++b) {
+            osc.process(frequency, output.data(), blockSize);
+            bench::doNotOptimize(output.data());
+        }
+    }
+
+    state.setItemsProcessed(state.iterations() * numBlocks * blockSize);
+}
+
+static void HybridHighNotes(bench::State& state)
+{
+    const float frequency = static_cast<float>(state.arg());
+    const unsigned additiveHarmonics = WavetableHybrid::calibrateAdditiveHarmonics(tableSize);
+    const WavetableHybrid wh = WavetableHybrid::createForHarmonicProfile(
+        bench::SawtoothProfile(), 1.0, tableSize, 44100, additiveHarmonics);
+
+    WavetableHybridOscillator osc;
+    osc.init(bench::sampleRate);
+    osc.setWavetable(&wh);
+
+    std::vector<float> output(blockSize);
+    while (state.keepRunning()) {
+        for (unsigned b = 0; b < numBlocks; ++b) {
+            osc.process(frequency, output.data(), blockSize);
+            bench::doNotOptimize(output.data());
+        }
+    }
+
+    const WavetableMulti wm = WavetableMulti::createForHarmonicProfile(
+        bench::SawtoothProfile(), 1.0, tableSize);
+    const size_t fullMemory = WavetableMulti::numTables() * wm.tableStride() * sizeof(float);
+    state.setItemsProcessed(state.iterations() * numBlocks * blockSize);
+    char label[96];
+    snprintf(label, sizeof(label), "up to %u harmonics, tables %zu KiB of %zu KiB",
+        additiveHarmonics, wh.tableMemory() / 1024, fullMemory / 1024);
+    state.setLabel(label);
+}
+
+BENCHMARK_ARGS(TableHighNotes, 1000, 2000, 4000, 8000);
+BENCHMARK_ARGS(HybridHighNotes, 1000, 2000, 4000, 8000);
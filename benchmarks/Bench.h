@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace bench {
+
+/**
+   The state of a running benchmark, which controls the timing loop.
+
+   A benchmark function repeats its measured code while `keepRunning()` is
+   true, and it reports how many items were processed, if applicable.
+ */
+class State {
+public:
+    State(long arg, double minTime);
+
+    // the parameter of this run
+    long arg() const { return _arg; }
+
+    // run one more iteration; the timer starts at the first call
+    bool keepRunning();
+
+    // exclude the duration of some setup code from the measurement
+    void pauseTiming();
+    void resumeTiming();
+
+    // set the total number of items processed by all iterations
+    void setItemsProcessed(uint64_t items) { _items = items; }
+
+    // attach a short description to the result
+    void setLabel(std::string label) { _label = std::move(label); }
+
+    uint64_t iterations() const { return _iterations; }
+    uint64_t itemsProcessed() const { return _items; }
+    double elapsedSeconds() const { return _elapsed; }
+    const std::string& label() const { return _label; }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    long _arg = 0;
+    double _minTime = 0;
+    uint64_t _iterations = 0;
+    uint64_t _items = 0;
+    double _elapsed = 0;
+    bool _started = false;
+    bool _paused = false;
+    clock::time_point _start;
+    std::string _label;
+};
+
+typedef void (*Function)(State&);
+
+/**
+   Registers a benchmark function at static initialization, to run once for
+   each of the given arguments, or once with argument 0 if there are none.
+ */
+struct Registrar {
+    Registrar(const char* name, Function function, std::vector<long> args = {});
+};
+
+// prevent the compiler from discarding a computed value
+template <class T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T* sink;
+    sink = &value;
+#endif
+}
+
+} // namespace bench
+
+#define BENCHMARK(fn) \
+    static ::bench::Registrar fn##_registrar(#fn, fn)
+#define BENCHMARK_ARGS(fn, ...) \
+    static ::bench::Registrar fn##_registrar(#fn, fn, { __VA_ARGS__ })
@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "Bench.h"
+#include <getopt.h>
+#include <map>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace bench {
+
+struct Entry {
+    const char* name;
+    Function function;
+    std::vector<long> args;
+};
+
+static std::vector<Entry>& registry()
+{
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+Registrar::Registrar(const char* name, Function function, std::vector<long> args)
+{
+    if (args.empty())
+        args.push_back(0);
+    registry().push_back(Entry { name, function, std::move(args) });
+}
+
+State::State(long arg, double minTime)
+    : _arg(arg), _minTime(minTime)
+{
+}
+
+bool State::keepRunning()
+{
+    clock::time_point now = clock::now();
+
+    if (!_started) {
+        _started = true;
+        _start = now;
+        return true;
+    }
+
+    ++_iterations;
+    if (!_paused) {
+        _elapsed += std::chrono::duration<double>(now - _start).count();
+        _start = now;
+    }
+    return _elapsed < _minTime;
+}
+
+void State::pauseTiming()
+{
+    _elapsed += std::chrono::duration<double>(clock::now() - _start).count();
+    _paused = true;
+}
+
+void State::resumeTiming()
+{
+    _start = clock::now();
+    _paused = false;
+}
+
+} // namespace bench
+
+struct Result {
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_iter = 0;
+    double items_per_sec = 0;
+    std::string label;
+};
+
+static void show_usage()
+{
+    fprintf(stderr,
+            "Usage: wavetable-bench [-f filter] [-t min-time] [-j json-file]\n"
+            "                       [-b baseline-json-file] [-r threshold-percent]\n"
+            "\n"
+            "  -f  run the benchmarks whose names contain the filter\n"
+            "  -t  minimum time of each benchmark, in seconds (default: 0.5)\n"
+            "  -j  write the results as JSON to the file, or - for the standard output\n"
+            "  -b  compare the times with the results of a previous run\n"
+            "  -r  slowdown from the baseline reported as a regression (default: 10)\n");
+}
+
+static void write_json_string(FILE *stream, const std::string &text)
+{
+    fputc('"', stream);
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            fprintf(stream, "\\%c", c);
+        else if ((unsigned char)c < 0x20)
+            fprintf(stream, "\\u%04x", (unsigned char)c);
+        else
+            fputc(c, stream);
+    }
+    fputc('"', stream);
+}
+
+// write one result per line, which is what the baseline reader expects
+static bool write_json_results(const char *path, const std::vector<Result> &results)
+{
+    FILE *stream = strcmp(path, "-") ? fopen(path, "w") : stdout;
+    if (!stream)
+        return false;
+
+    fprintf(stream, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+        fprintf(stream, "    {\"name\": ");
+        write_json_string(stream, result.name);
+        fprintf(stream, ", \"iterations\": %llu, \"ns_per_iteration\": %.6g, \"items_per_second\": %.6g, \"label\": ",
+                (unsigned long long)result.iterations, result.ns_per_iter, result.items_per_sec);
+        write_json_string(stream, result.label);
+        fprintf(stream, "}%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(stream, "  ]\n}\n");
+
+    bool ok = fflush(stream) == 0 && !ferror(stream);
+    if (stream != stdout)
+        ok = fclose(stream) == 0 && ok;
+    return ok;
+}
+
+// read the names and times of a file written by `write_json_results`
+static bool read_json_baseline(const char *path, std::map<std::string, double> &times)
+{
+    FILE *stream = fopen(path, "r");
+    if (!stream)
+        return false;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), stream)) {
+        const char *name = strstr(line, "\"name\": \"");
+        const char *time = strstr(line, "\"ns_per_iteration\": ");
+        if (!name || !time)
+            continue;
+        name += strlen("\"name\": \"");
+        const char *name_end = strchr(name, '"');
+        if (!name_end)
+            continue;
+        times[std::string(name, name_end)] = atof(time + strlen("\"ns_per_iteration\": "));
+    }
+
+    fclose(stream);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filter = nullptr;
+    double min_time = 0.5;
+    const char *json_path = nullptr;
+    const char *baseline_path = nullptr;
+    double threshold = 10.0;
+
+    for (int c; (c = getopt(argc, argv, "hf:t:j:b:r:")) != -1;) {
+        switch (c) {
+        case 'h':
+            show_usage();
+            return 0;
+        case 'f':
+            filter = optarg;
+            break;
+        case 't':
+            min_time = atof(optarg);
+            break;
+        case 'j':
+            json_path = optarg;
+            break;
+        case 'b':
+            baseline_path = optarg;
+            break;
+        case 'r':
+            threshold = atof(optarg);
+            break;
+        default:
+            return 1;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (baseline_path && !read_json_baseline(baseline_path, baseline)) {
+        fprintf(stderr, "Cannot read the baseline file.\n");
+        return 1;
+    }
+
+    // the text table goes to the standard error when JSON takes the output
+    FILE *text = (json_path && !strcmp(json_path, "-")) ? stderr : stdout;
+
+    fprintf(text, "%-40s %14s %14s %16s\n", "Benchmark", "Iterations", "Time/iter (ns)", "Items/s");
+
+    std::vector<Result> results;
+    unsigned regressions = 0;
+
+    for (const bench::Entry &entry : bench::registry()) {
+        if (filter && !strstr(entry.name, filter))
+            continue;
+
+        for (long arg : entry.args) {
+            bench::State state(arg, min_time);
+            entry.function(state);
+
+            char name[256];
+            snprintf(name, sizeof(name), "%s/%ld", entry.name, arg);
+
+            Result result;
+            result.name = name;
+            result.iterations = state.iterations();
+            double seconds = state.elapsedSeconds();
+            result.ns_per_iter = result.iterations ? (1e9 * seconds / result.iterations) : 0.0;
+            result.items_per_sec = (seconds > 0) ? (state.itemsProcessed() / seconds) : 0.0;
+            result.label = state.label();
+
+            std::string comparison;
+            auto it = baseline.find(result.name);
+            if (it != baseline.end() && it->second > 0 && result.ns_per_iter > 0) {
+                double change = 100.0 * (result.ns_per_iter / it->second - 1.0);
+                char buffer[64];
+                bool regressed = change > threshold;
+                snprintf(buffer, sizeof(buffer), " [%+.1f%%%s]", change, regressed ? " REGRESSION" : "");
+                comparison = buffer;
+                regressions += regressed;
+            }
+
+            fprintf(text, "%-40s %14llu %14.1f %16.4g %s%s\n", name,
+                    (unsigned long long)result.iterations, result.ns_per_iter, result.items_per_sec,
+                    result.label.c_str(), comparison.c_str());
+            fflush(text);
+
+            results.push_back(std::move(result));
+        }
+    }
+
+    if (json_path && !write_json_results(json_path, results)) {
+        fprintf(stderr, "Cannot write the JSON file.\n");
+        return 1;
+    }
+
+    if (regressions > 0) {
+        fprintf(stderr, "%u regressions above %.1f%% from the baseline.\n", regressions, threshold);
+        return 2;
+    }
+
+    return 0;
+}
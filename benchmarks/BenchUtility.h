@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+#include "sfizz/Wavetables.h"
+#include <vector>
+#include <cmath>
+
+namespace bench {
+
+// sample rate of the rendering benchmarks
+constexpr double sampleRate = 48000.0;
+
+// a naive sawtooth wave, to be converted to a wavetable
+inline std::vector<float> sawtoothWave(unsigned size)
+{
+    std::vector<float> wave(size);
+    for (unsigned i = 0; i < size; ++i)
+        wave[i] = 2.0f * i / size - 1.0f;
+    return wave;
+}
+
+// the harmonics of a sawtooth wave
+class SawtoothProfile : public sfz::HarmonicProfile {
+public:
+    std::complex<double> getHarmonic(size_t index) const override
+    {
+        if (index == 0)
+            return 0.0;
+        return std::polar(2.0 / (M_PI * index), (index & 1) ? M_PI / 2 : -M_PI / 2);
+    }
+};
+
+// a sine wave, whose harmonics other than the fundamental are distortion
+class SineProfile : public sfz::HarmonicProfile {
+public:
+    std::complex<double> getHarmonic(size_t index) const override
+    {
+        return (index == 1) ? 1.0 : 0.0;
+    }
+};
+
+inline sfz::WavetableMulti sawtoothWavetable(unsigned tableSize)
+{
+    std::vector<float> wave = sawtoothWave(tableSize);
+    return sfz::WavetableMulti::createFromAudioData(wave, 1.0, tableSize);
+}
+
+// an exponential frequency sweep, from f1 to f2, of the given length
+inline std::vector<float> frequencySweep(float f1, float f2, unsigned length)
+{
+    std::vector<float> freqs(length);
+    for (unsigned i = 0; i < length; ++i)
+        freqs[i] = f1 * std::pow(f2 / f1, static_cast<float>(i) / length);
+    return freqs;
+}
+
+} // namespace bench
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Compares the FFT backends, by a forward and inverse real transform, and
+// checks the DFT of real data of any length.
+
+#include "Bench.h"
+#include "sfizz/FFT.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+
+static void benchmarkRealFFT(bench::State& state, sfz::FFTBackend backend)
+{
+    const size_t size = static_cast<size_t>(state.arg());
+
+    std::vector<float> input(size);
+    std::vector<std::complex<float>> spectrum(size / 2 + 1);
+    std::vector<float> output(size);
+
+    std::mt19937 prng;
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (float& x : input)
+        x = dist(prng);
+
+    sfz::RealFFT fft(size, backend);
+    state.setLabel(sfz::fftBackendName(fft.backend()));
+
+    while (state.keepRunning()) {
+        fft.forward(input.data(), spectrum.data());
+        fft.inverse(spectrum.data(), output.data());
+        bench::doNotOptimize(output[0]);
+    }
+
+    state.setItemsProcessed(state.iterations() * size);
+}
+
+static void RealFFTKiss(bench::State& state)
+{
+    benchmarkRealFFT(state, sfz::FFTBackend::KissFFT);
+}
+
+static void RealFFTRadix2(bench::State& state)
+{
+    benchmarkRealFFT(state, sfz::FFTBackend::Radix2);
+}
+
+BENCHMARK_ARGS(RealFFTKiss, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536);
+BENCHMARK_ARGS(RealFFTRadix2, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536);
+
+// The DFT of a single-cycle sine of any length, whose label is the largest
+// bin past the fundamental, relative to it; odd lengths and lengths with
+// large prime factors take Bluestein's algorithm.
+static void RealDFTAnyLength(bench::State& state)
+{
+    const size_t size = static_cast<size_t>(state.arg());
+
+    std::vector<float> input(size);
+    for (size_t i = 0; i < size; ++i)
+        input[i] = static_cast<float>(std::sin(2 * M_PI * i / size));
+
+    // more bins than the data has, which are expected to be zero above its
+    // Nyquist frequency
+    std::vector<std::complex<float>> spectrum(size + 16);
+
+    while (state.keepRunning()) {
+        sfz::computeRealDFT(input, spectrum);
+        bench::doNotOptimize(spectrum[1]);
+    }
+
+    float spurious = 0.0f;
+    for (size_t k = 2; k < spectrum.size(); ++k)
+        spurious = std::max(spurious, std::abs(spectrum[k]));
+
+    state.setItemsProcessed(state.iterations() * size);
+    char label[64];
+    snprintf(label, sizeof(label), "spurious %.0f dB",
+        20 * std::log10(std::max(1e-12f, spurious / std::abs(spectrum[1]))));
+    state.setLabel(label);
+}
+
+BENCHMARK_ARGS(RealDFTAnyLength, 1000, 1001, 1009, 2048);
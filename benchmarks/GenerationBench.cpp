@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Measures the generation of the mipmaps: the creation from audio data, the
+// generation of each level from a harmonic profile, and the guard elements.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+
+using sfz::WavetableMulti;
+using sfz::MipmapRange;
+
+static constexpr unsigned levelTableSize = 2048;
+static constexpr double refSampleRate = 44100.0;
+
+static void CreateFromAudioData(bench::State& state)
+{
+    const unsigned tableSize = static_cast<unsigned>(state.arg());
+    const std::vector<float> wave = bench::sawtoothWave(tableSize);
+
+    while (state.keepRunning()) {
+        WavetableMulti wm = WavetableMulti::createFromAudioData(wave, 1.0, tableSize);
+        bench::doNotOptimize(wm.getTable(0)[0]);
+    }
+
+    state.setItemsProcessed(state.iterations() * tableSize * MipmapRange::N);
+}
+
+static void GenerateLevel(bench::State& state)
+{
+    const unsigned level = static_cast<unsigned>(state.arg());
+    const bench::SawtoothProfile profile;
+    std::vector<float> table(levelTableSize);
+
+    // the cutoff of the level, like the generation of a mipmap
+    const MipmapRange range = MipmapRange::getRangeForIndex(level);
+    const double cutoff = (0.5 * refSampleRate / levelTableSize) / range.maxFrequency;
+
+    while (state.keepRunning()) {
+        profile.generate(table, 1.0, cutoff);
+        bench::doNotOptimize(table[0]);
+    }
+
+    state.setItemsProcessed(state.iterations() * levelTableSize);
+}
+
+static void FillExtra(bench::State& state)
+{
+    const unsigned tableSize = static_cast<unsigned>(state.arg());
+    WavetableMulti wm = bench::sawtoothWavetable(tableSize);
+
+    while (state.keepRunning()) {
+        wm.fillExtra();
+        bench::doNotOptimize(wm.getTable(0)[0]);
+    }
+
+    state.setItemsProcessed(state.iterations() * MipmapRange::N);
+}
+
+BENCHMARK_ARGS(CreateFromAudioData, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536);
+BENCHMARK_ARGS(GenerateLevel, 0, 4, 8, 12, 16, 20, 23);
+BENCHMARK_ARGS(FillExtra, 256, 2048, 65536);
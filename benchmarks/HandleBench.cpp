@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Measures the cost of the blocks of an audio thread on a multisample handle,
+// and stresses the handle: render threads play blocks while an editor
+// publishes new multisamples as fast as it generates them. The label counts
+// the blocks, those with invalid output, and the multisamples which remain
+// retired at the end.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+#include "sfizz/WavetableHandle.h"
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+
+using sfz::WavetableHandle;
+using sfz::WavetableMulti;
+using sfz::WavetableOscillator;
+
+static constexpr unsigned blockSize = 64;
+static constexpr unsigned numBlocks = 1024;
+static constexpr unsigned stressTableSize = 256;
+
+static std::unique_ptr<const WavetableMulti> stressWavetable(double amplitude)
+{
+    return std::unique_ptr<const WavetableMulti>(new WavetableMulti(
+        WavetableMulti::createForHarmonicProfile(bench::SawtoothProfile(), amplitude, stressTableSize)));
+}
+
+// the largest magnitude in the tables of a multisample
+static float peakAmplitude(const WavetableMulti& wave)
+{
+    float peak = 0.0f;
+    for (unsigned m = 0; m < WavetableMulti::numTables(); ++m) {
+        for (float x : wave.getTable(m))
+            peak = std::max(peak, std::fabs(x));
+    }
+    return peak;
+}
+
+static void HandleBlock(bench::State& state)
+{
+    WavetableHandle handle;
+    handle.publish(stressWavetable(1.0));
+    const unsigned reader = static_cast<unsigned>(handle.addReader());
+
+    while (state.keepRunning()) {
+        for (unsigned b = 0; b < numBlocks; ++b) {
+            const WavetableMulti* wave = handle.beginBlock(reader);
+            bench::doNotOptimize(wave);
+            handle.endBlock(reader);
+        }
+    }
+
+    handle.removeReader(reader);
+    state.setItemsProcessed(state.iterations() * numBlocks);
+}
+
+static void HandleStress(bench::State& state)
+{
+    const unsigned numReaders = static_cast<unsigned>(state.arg());
+
+    // the output is valid under the peak of the loudest multisample
+    const float validPeak = 1.01f * peakAmplitude(*stressWavetable(1.0));
+
+    WavetableHandle handle;
+    handle.publish(stressWavetable(1.0));
+
+    std::atomic<bool> running { true };
+    std::atomic<uint64_t> blocks { 0 };
+    std::atomic<uint64_t> invalid { 0 };
+
+    auto render = [&]() {
+        const unsigned reader = static_cast<unsigned>(handle.addReader());
+        WavetableOscillator osc;
+        osc.init(bench::sampleRate);
+        float output[blockSize];
+        float frequency = 110.0f;
+
+        while (running.load(std::memory_order_relaxed)) {
+            const WavetableMulti* wave = handle.beginBlock(reader);
+            osc.setWavetable(wave);
+            osc.process(frequency, output, blockSize);
+            handle.endBlock(reader);
+
+            for (float x : output) {
+                if (!(std::fabs(x) < validPeak)) {
+                    invalid.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+            blocks.fetch_add(1, std::memory_order_relaxed);
+            frequency = (frequency < 8000.0f) ? (frequency * 1.01f) : 110.0f;
+        }
+
+        handle.removeReader(reader);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned r = 0; r < numReaders; ++r)
+        threads.emplace_back(render);
+
+    unsigned count = 0;
+    while (state.keepRunning())
+        handle.publish(stressWavetable(0.5 + 0.5 * (++count % 2)));
+
+    running.store(false);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    state.setItemsProcessed(state.iterations());
+    char label[96];
+    snprintf(label, sizeof(label), "%llu blocks, %llu invalid, %zu retired",
+        static_cast<unsigned long long>(blocks.load()),
+        static_cast<unsigned long long>(invalid.load()), handle.reclaim());
+    state.setLabel(label);
+}
+
+BENCHMARK(HandleBlock);
+BENCHMARK_ARGS(HandleStress, 1, 2, 4);
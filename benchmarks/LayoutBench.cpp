@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Compares the planar and the interleaved layouts of the mipmap, when reading
+// with a crossfade between adjacent tables during a frequency sweep.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+
+using sfz::WavetableMulti;
+using sfz::MipmapRange;
+
+static constexpr unsigned sweepLength = 48000;
+
+static void CrossfadePlanar(bench::State& state)
+{
+    const unsigned tableSize = static_cast<unsigned>(state.arg());
+    const WavetableMulti wm = bench::sawtoothWavetable(tableSize);
+    const std::vector<float> freqs = bench::frequencySweep(20.0f, 20000.0f, sweepLength);
+
+    float phase = 0.0f;
+    while (state.keepRunning()) {
+        float sum = 0.0f;
+        for (float f : freqs) {
+            float t = MipmapRange::getIndexForFrequency(f);
+            unsigned m = static_cast<unsigned>(t);
+            float blend = t - m;
+            const float* y1 = wm.getTable(m).data();
+            const float* y2 = wm.getTable(std::min(m + 1, MipmapRange::N - 1)).data();
+
+            float pos = phase * tableSize;
+            unsigned i = static_cast<unsigned>(pos);
+            float mu = pos - i;
+            float a = y1[i] + mu * (y1[i + 1] - y1[i]);
+            float b = y2[i] + mu * (y2[i + 1] - y2[i]);
+            sum += a + blend * (b - a);
+
+            phase += f * static_cast<float>(1.0 / bench::sampleRate);
+            phase -= static_cast<int>(phase);
+        }
+        bench::doNotOptimize(sum);
+    }
+
+    state.setItemsProcessed(state.iterations() * sweepLength);
+}
+
+static void CrossfadeInterleaved(bench::State& state)
+{
+    const unsigned tableSize = static_cast<unsigned>(state.arg());
+    WavetableMulti wm = bench::sawtoothWavetable(tableSize);
+    wm.interleavePairs();
+    const std::vector<float> freqs = bench::frequencySweep(20.0f, 20000.0f, sweepLength);
+
+    float phase = 0.0f;
+    while (state.keepRunning()) {
+        float sum = 0.0f;
+        for (float f : freqs) {
+            float t = MipmapRange::getIndexForFrequency(f);
+            unsigned m = static_cast<unsigned>(t);
+            float blend = t - m;
+
+            float pos = phase * tableSize;
+            unsigned i = static_cast<unsigned>(pos);
+            float mu = pos - i;
+            const float* y = wm.getInterleavedPair(m) + 2 * i;
+            float a = y[0] + mu * (y[2] - y[0]);
+            float b = y[1] + mu * (y[3] - y[1]);
+            sum += a + blend * (b - a);
+
+            phase += f * static_cast<float>(1.0 / bench::sampleRate);
+            phase -= static_cast<int>(phase);
+        }
+        bench::doNotOptimize(sum);
+    }
+
+    state.setItemsProcessed(state.iterations() * sweepLength);
+}
+
+BENCHMARK_ARGS(CrossfadePlanar, 256, 2048, 8192, 65536);
+BENCHMARK_ARGS(CrossfadeInterleaved, 256, 2048, 8192, 65536);
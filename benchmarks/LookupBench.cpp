@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Compares the mipmap index by lookup table with the exact logarithm, over a
+// frequency sweep; the label of the lookup is its maximum error.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+#include <cmath>
+#include <cstdio>
+
+using sfz::MipmapRange;
+
+static constexpr unsigned sweepLength = 4096;
+
+static void MipmapIndexLookup(bench::State& state)
+{
+    const std::vector<float> freqs = bench::frequencySweep(10.0f, 22000.0f, sweepLength);
+
+    while (state.keepRunning()) {
+        float sum = 0.0f;
+        for (float f : freqs)
+            sum += MipmapRange::getIndexForFrequency(f);
+        bench::doNotOptimize(sum);
+    }
+
+    float maxError = 0.0f;
+    for (float f : freqs) {
+        float error = MipmapRange::getIndexForFrequency(f) - MipmapRange::getExactIndexForFrequency(f);
+        maxError = std::max(maxError, std::fabs(error));
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "max error %.3g", maxError);
+    state.setItemsProcessed(state.iterations() * sweepLength);
+    state.setLabel(label);
+}
+
+static void MipmapIndexExact(bench::State& state)
+{
+    const std::vector<float> freqs = bench::frequencySweep(10.0f, 22000.0f, sweepLength);
+
+    while (state.keepRunning()) {
+        float sum = 0.0f;
+        for (float f : freqs)
+            sum += MipmapRange::getExactIndexForFrequency(f);
+        bench::doNotOptimize(sum);
+    }
+
+    state.setItemsProcessed(state.iterations() * sweepLength);
+}
+
+BENCHMARK(MipmapIndexLookup);
+BENCHMARK(MipmapIndexExact);
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Measures the writers of the mipmaps in each output format, by bytes written
+// to a temporary file.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+#include "mipmap_output.h"
+#include <cstdio>
+
+using sfz::WavetableMulti;
+using sfz::MipmapRange;
+
+static void writeMipmap(bench::State& state, OutputFormat format)
+{
+    const unsigned tableSize = static_cast<unsigned>(state.arg());
+    const WavetableMulti wm = bench::sawtoothWavetable(tableSize);
+
+    FILE* stream = tmpfile();
+    if (!stream) {
+        state.setLabel("cannot create a temporary file");
+        while (state.keepRunning())
+            ;
+        return;
+    }
+
+    uint64_t bytes = 0;
+    while (state.keepRunning()) {
+        rewind(stream);
+        std::unique_ptr<MipmapWriter> writer = create_mipmap_writer(format, stream);
+        writer->begin(tableSize);
+        for (unsigned m = 0; m < MipmapRange::N; ++m)
+            writer->write_table(m, wm.getTable(m));
+        writer->end();
+        fflush(stream);
+        bytes += static_cast<uint64_t>(ftell(stream));
+    }
+
+    fclose(stream);
+    state.setItemsProcessed(bytes);
+    state.setLabel("items are bytes");
+}
+
+static void WriteMipmapFaust(bench::State& state)
+{
+    writeMipmap(state, OutputFormat::Faust);
+}
+
+static void WriteMipmapBinary(bench::State& state)
+{
+    writeMipmap(state, OutputFormat::Binary);
+}
+
+static void WriteMipmapWav(bench::State& state)
+{
+    writeMipmap(state, OutputFormat::Wav);
+}
+
+BENCHMARK_ARGS(WriteMipmapFaust, 256, 2048);
+BENCHMARK_ARGS(WriteMipmapBinary, 256, 2048);
+BENCHMARK_ARGS(WriteMipmapWav, 256, 2048);
@@ -0,0 +1,461 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Measures the quality of the oscillator against its cost, for a grid of
+// configurations of table size, reference sample rate and interpolation.
+//
+// Each configuration renders a stepped exponential sweep, which is steady
+// within each analysis frame so that the harmonics fall on known bins. The
+// frames of a rich waveform give the energy of aliasing, which is outside
+// the bins of the harmonics, and the frames of a sine wave give the THD+N,
+// which is outside the bins of the fundamental. The render time per sample
+// is measured on the sweep of the rich waveform.
+
+#include "BenchUtility.h"
+#include "sfizz/FFT.h"
+#include <dr_wav.h>
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using sfz::WavetableMulti;
+using sfz::WavetableOscillator;
+using sfz::WavetableInterpolation;
+using sfz::MipmapRange;
+
+// size of the analysis frames, and half-width of the region of a harmonic,
+// in bins, which covers the main lobe of the window
+static constexpr unsigned frame_size = 16384;
+static constexpr unsigned lobe_bins = 8;
+
+struct SweepOptions {
+    double sample_rate = 48000;
+    double f1 = 100;
+    double f2 = 20000;
+    unsigned steps = 48;
+};
+
+struct QualityConfig {
+    unsigned table_size = 2048;
+    double ref_sample_rate = 44100;
+    WavetableInterpolation interpolation = WavetableInterpolation::Linear;
+};
+
+struct QualityResult {
+    QualityConfig config;
+    // ratio of the energy of aliasing to the total, mean and worst frame
+    double aliasing_db = 0;
+    double worst_aliasing_db = 0;
+    // ratio of the energy of distortion and noise to the fundamental
+    double thdn_db = 0;
+    double worst_thdn_db = 0;
+    double ns_per_sample = 0;
+    size_t memory_bytes = 0;
+};
+
+static const char *interpolation_name(WavetableInterpolation interpolation)
+{
+    return (interpolation == WavetableInterpolation::Cubic) ? "cubic" : "linear";
+}
+
+static double to_db(double ratio)
+{
+    return 10.0 * std::log10(std::max(ratio, 1e-30));
+}
+
+//------------------------------------------------------------------------------
+// a 7-term Blackman-Harris window, whose side lobes are below the noise of
+// single precision, and whose main lobe spans 7 bins on each side
+static std::vector<float> analysis_window()
+{
+    static const double a[7] = {
+        0.27105140069342, -0.43329793923448, 0.21812299954311, -0.06592544638803,
+        0.01081174209837, -0.00077658482522, 0.00001388721735,
+    };
+
+    std::vector<float> window(frame_size);
+    for (unsigned i = 0; i < frame_size; ++i) {
+        double x = 2.0 * M_PI * i / frame_size;
+        double w = 0;
+        for (unsigned k = 0; k < 7; ++k)
+            w += a[k] * std::cos(k * x);
+        window[i] = (float)w;
+    }
+    return window;
+}
+
+/**
+   Analyze a frame of a steady tone of the given frequency, in bins, and
+   split its energy in the regions of the first harmonics and the rest.
+ */
+static void analyze_frame(const float *frame, const std::vector<float> &window, double f0_bins,
+                          unsigned num_harmonics, double &harmonic_energy, double &other_energy)
+{
+    std::vector<float> input(frame_size);
+    for (unsigned i = 0; i < frame_size; ++i)
+        input[i] = frame[i] * window[i];
+
+    const unsigned num_bins = frame_size / 2 + 1;
+    std::vector<std::complex<float>> spectrum(num_bins);
+    sfz::getCachedRealFFT(frame_size).forward(input.data(), spectrum.data());
+
+    std::vector<bool> in_harmonic(num_bins, false);
+    for (unsigned k = 1; k <= num_harmonics; ++k) {
+        double center = k * f0_bins;
+        if (center >= num_bins)
+            break;
+        long lo = std::max(0L, (long)std::floor(center) - (long)lobe_bins);
+        long hi = std::min((long)num_bins - 1, (long)std::ceil(center) + (long)lobe_bins);
+        for (long b = lo; b <= hi; ++b)
+            in_harmonic[b] = true;
+    }
+
+    harmonic_energy = 0;
+    other_energy = 0;
+    for (unsigned b = 0; b < num_bins; ++b) {
+        double e = std::norm(spectrum[b]);
+        (in_harmonic[b] ? harmonic_energy : other_energy) += e;
+    }
+}
+
+/**
+   Render the sweep of a wavetable, analyzing each step; the harmonics up to
+   `max_harmonics` are the wanted signal, or all below Nyquist if 0.
+   Steps which are too low for the harmonics to be resolved are skipped.
+ */
+static void measure_sweep(const WavetableMulti &wm, WavetableInterpolation interpolation,
+                          const SweepOptions &sweep, unsigned max_harmonics,
+                          double &mean_db, double &worst_db, double *ns_per_sample)
+{
+    WavetableOscillator osc;
+    osc.init(sweep.sample_rate);
+    osc.setWavetable(&wm);
+    osc.setInterpolation(interpolation);
+
+    const std::vector<float> window = analysis_window();
+    std::vector<float> frame(frame_size);
+
+    double total_wanted = 0;
+    double total_other = 0;
+    double worst_ratio = 0;
+    double render_seconds = 0;
+    unsigned long rendered = 0;
+
+    // warm up the caches before timing
+    osc.process((float)sweep.f1, frame.data(), frame_size);
+
+    for (unsigned s = 0; s < sweep.steps; ++s) {
+        double t = (sweep.steps > 1) ? (double)s / (sweep.steps - 1) : 0.0;
+        double freq = sweep.f1 * std::pow(sweep.f2 / sweep.f1, t);
+        double f0_bins = freq * frame_size / sweep.sample_rate;
+
+        auto start = std::chrono::steady_clock::now();
+        osc.process((float)freq, frame.data(), frame_size);
+        render_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rendered += frame_size;
+
+        unsigned num_harmonics = max_harmonics;
+        if (num_harmonics == 0) {
+            // the harmonics must be apart enough for the rest to be measured
+            if (f0_bins < 4 * lobe_bins)
+                continue;
+            num_harmonics = (unsigned)(0.5 * sweep.sample_rate / freq);
+        }
+
+        double wanted, other;
+        analyze_frame(frame.data(), window, f0_bins, num_harmonics, wanted, other);
+        if (max_harmonics == 0) {
+            total_wanted += wanted + other;
+            worst_ratio = std::max(worst_ratio, other / (wanted + other));
+        }
+        else {
+            total_wanted += wanted;
+            worst_ratio = std::max(worst_ratio, other / wanted);
+        }
+        total_other += other;
+    }
+
+    mean_db = to_db(total_other / total_wanted);
+    worst_db = to_db(worst_ratio);
+    if (ns_per_sample)
+        *ns_per_sample = 1e9 * render_seconds / rendered;
+}
+
+static QualityResult measure_config(const QualityConfig &config, const std::vector<float> &wave,
+                                    unsigned cycles, const SweepOptions &sweep)
+{
+    QualityResult result;
+    result.config = config;
+
+    const WavetableMulti rich = WavetableMulti::createFromAudioData(
+        wave, 1.0, config.table_size, config.ref_sample_rate, cycles);
+    measure_sweep(rich, config.interpolation, sweep, 0,
+                  result.aliasing_db, result.worst_aliasing_db, &result.ns_per_sample);
+
+    const WavetableMulti sine = WavetableMulti::createForHarmonicProfile(
+        bench::SineProfile(), 1.0, config.table_size, config.ref_sample_rate);
+    measure_sweep(sine, config.interpolation, sweep, 1,
+                  result.thdn_db, result.worst_thdn_db, nullptr);
+
+    result.memory_bytes = (size_t)WavetableMulti::numTables() * rich.tableStride() * sizeof(float);
+    return result;
+}
+
+//------------------------------------------------------------------------------
+static bool read_wave_file(const char *path, std::vector<float> &wave)
+{
+    drwav wav;
+    if (!drwav_init_file(&wav, path, nullptr))
+        return false;
+
+    const size_t frames = (size_t)wav.totalPCMFrameCount;
+    const unsigned channels = wav.channels;
+    std::vector<float> data(frames * channels);
+    bool ok = channels > 0 && frames >= 4 &&
+        drwav_read_pcm_frames_f32(&wav, frames, data.data()) == frames;
+    drwav_uninit(&wav);
+    if (!ok)
+        return false;
+
+    // the first channel
+    wave.resize(frames);
+    for (size_t i = 0; i < frames; ++i)
+        wave[i] = data[i * channels];
+    return true;
+}
+
+template <class T, class Parse>
+static bool parse_list(const char *text, std::vector<T> &values, Parse parse)
+{
+    values.clear();
+    std::string list = text;
+    for (size_t start = 0; start <= list.size();) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+        T value;
+        if (!parse(list.substr(start, end - start), value))
+            return false;
+        values.push_back(value);
+        start = end + 1;
+    }
+    return !values.empty();
+}
+
+static bool parse_table_size(const std::string &text, unsigned &size)
+{
+    char *end;
+    unsigned long value = strtoul(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || value < 4 || value > (1ul << 24) || (value & 1))
+        return false;
+    size = (unsigned)value;
+    return true;
+}
+
+static bool parse_rate(const std::string &text, double &rate)
+{
+    char *end;
+    rate = strtod(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0' && rate > 0;
+}
+
+static bool parse_interpolation(const std::string &text, WavetableInterpolation &interpolation)
+{
+    if (text == "linear")
+        interpolation = WavetableInterpolation::Linear;
+    else if (text == "cubic")
+        interpolation = WavetableInterpolation::Cubic;
+    else
+        return false;
+    return true;
+}
+
+static void write_json_result(FILE *stream, const QualityResult &r)
+{
+    fprintf(stream,
+            "{\"table_size\": %u, \"ref_sample_rate\": %g, \"interpolation\": \"%s\", "
+            "\"aliasing_db\": %.2f, \"worst_aliasing_db\": %.2f, \"thdn_db\": %.2f, \"worst_thdn_db\": %.2f, "
+            "\"ns_per_sample\": %.3f, \"memory_bytes\": %zu}\n",
+            r.config.table_size, r.config.ref_sample_rate, interpolation_name(r.config.interpolation),
+            r.aliasing_db, r.worst_aliasing_db, r.thdn_db, r.worst_thdn_db, r.ns_per_sample, r.memory_bytes);
+}
+
+static void show_usage()
+{
+    fprintf(stderr,
+            "Usage: wavetable-quality [-i wave-file] [-c cycles] [-s sizes] [-R ref-rates]\n"
+            "                         [-m interpolations] [-r sample-rate] [-l low-freq]\n"
+            "                         [-u high-freq] [-n steps] [-a aliasing-dB]\n"
+            "                         [-d thdn-dB] [-j json-file]\n"
+            "\n"
+            "  -i  waveform to convert (default: a sawtooth)\n"
+            "  -c  number of periods in the sound file (default: 1)\n"
+            "  -s  table sizes, separated by commas (default: 256,512,1024,2048,4096)\n"
+            "  -R  reference sample rates of the tables (default: 44100)\n"
+            "  -m  interpolations, linear or cubic (default: linear,cubic)\n"
+            "  -r  sample rate of the rendering (default: 48000)\n"
+            "  -l  start frequency of the sweep (default: 100)\n"
+            "  -u  end frequency of the sweep (default: 20000)\n"
+            "  -n  number of steps of the sweep (default: 48)\n"
+            "  -a  target of the worst aliasing, to select a configuration\n"
+            "  -d  target of the worst THD+N, to select a configuration\n"
+            "  -j  write the results as JSON lines to the file, or - for the standard output\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *input_path = nullptr;
+    unsigned cycles = 1;
+    std::vector<unsigned> sizes { 256, 512, 1024, 2048, 4096 };
+    std::vector<double> ref_rates { 44100 };
+    std::vector<WavetableInterpolation> interpolations { WavetableInterpolation::Linear, WavetableInterpolation::Cubic };
+    SweepOptions sweep;
+    bool has_aliasing_target = false;
+    bool has_thdn_target = false;
+    double aliasing_target = 0;
+    double thdn_target = 0;
+    const char *json_path = nullptr;
+
+    for (int c; (c = getopt(argc, argv, "hi:c:s:R:m:r:l:u:n:a:d:j:")) != -1;) {
+        bool valid = true;
+        switch (c) {
+        case 'h':
+            show_usage();
+            return 0;
+        case 'i':
+            input_path = optarg;
+            break;
+        case 'c':
+            cycles = (unsigned)atoi(optarg);
+            valid = cycles >= 1;
+            break;
+        case 's':
+            valid = parse_list(optarg, sizes, parse_table_size);
+            break;
+        case 'R':
+            valid = parse_list(optarg, ref_rates, parse_rate);
+            break;
+        case 'm':
+            valid = parse_list(optarg, interpolations, parse_interpolation);
+            break;
+        case 'r':
+            valid = parse_rate(optarg, sweep.sample_rate);
+            break;
+        case 'l':
+            valid = parse_rate(optarg, sweep.f1);
+            break;
+        case 'u':
+            valid = parse_rate(optarg, sweep.f2);
+            break;
+        case 'n':
+            sweep.steps = (unsigned)atoi(optarg);
+            valid = sweep.steps >= 1;
+            break;
+        case 'a':
+            has_aliasing_target = true;
+            aliasing_target = atof(optarg);
+            break;
+        case 'd':
+            has_thdn_target = true;
+            thdn_target = atof(optarg);
+            break;
+        case 'j':
+            json_path = optarg;
+            break;
+        default:
+            return 1;
+        }
+        if (!valid) {
+            fprintf(stderr, "Invalid value of option -%c.\n", c);
+            return 1;
+        }
+    }
+
+    if (sweep.f2 >= 0.5 * sweep.sample_rate || sweep.f1 >= sweep.f2) {
+        fprintf(stderr, "The sweep must rise, below the Nyquist frequency.\n");
+        return 1;
+    }
+
+    std::vector<float> wave;
+    if (!input_path)
+        wave = bench::sawtoothWave(4096);
+    else if (!read_wave_file(input_path, wave)) {
+        fprintf(stderr, "Cannot read the sound file.\n");
+        return 1;
+    }
+    if (wave.size() < 2 * (size_t)cycles) {
+        fprintf(stderr, "Sound data is too small for the number of cycles.\n");
+        return 1;
+    }
+
+    FILE *json = nullptr;
+    if (json_path) {
+        json = strcmp(json_path, "-") ? fopen(json_path, "w") : stdout;
+        if (!json) {
+            fprintf(stderr, "Cannot open the JSON file.\n");
+            return 1;
+        }
+    }
+    FILE *text = (json == stdout) ? stderr : stdout;
+
+    // the geometry of the mipmap is fixed when building
+    fprintf(text, "Mipmap: %u tables from %g Hz to %g Hz; sweep: %g Hz to %g Hz in %u steps at %g Hz\n\n",
+            MipmapRange::N, (double)MipmapRange::F1, (double)MipmapRange::FN,
+            sweep.f1, sweep.f2, sweep.steps, sweep.sample_rate);
+    fprintf(text, "%8s %9s %7s %14s %11s %11s %11s %10s %11s\n", "Size", "Ref rate", "Interp",
+            "Aliasing (dB)", "worst", "THD+N (dB)", "worst", "ns/sample", "Memory (KiB)");
+
+    std::vector<QualityResult> results;
+    for (unsigned size : sizes) {
+        for (double ref_rate : ref_rates) {
+            for (WavetableInterpolation interpolation : interpolations) {
+                QualityConfig config;
+                config.table_size = size;
+                config.ref_sample_rate = ref_rate;
+                config.interpolation = interpolation;
+
+                QualityResult r = measure_config(config, wave, cycles, sweep);
+                fprintf(text, "%8u %9g %7s %14.2f %11.2f %11.2f %11.2f %10.3f %11.1f\n",
+                        size, ref_rate, interpolation_name(interpolation),
+                        r.aliasing_db, r.worst_aliasing_db, r.thdn_db, r.worst_thdn_db,
+                        r.ns_per_sample, r.memory_bytes / 1024.0);
+                fflush(text);
+                if (json)
+                    write_json_result(json, r);
+                results.push_back(r);
+            }
+        }
+    }
+
+    if (json && json != stdout)
+        fclose(json);
+
+    if (!has_aliasing_target && !has_thdn_target)
+        return 0;
+
+    // the cheapest configuration to render which meets the targets
+    const QualityResult *best = nullptr;
+    for (const QualityResult &r : results) {
+        if (has_aliasing_target && r.worst_aliasing_db > aliasing_target)
+            continue;
+        if (has_thdn_target && r.worst_thdn_db > thdn_target)
+            continue;
+        if (!best || r.ns_per_sample < best->ns_per_sample ||
+            (r.ns_per_sample == best->ns_per_sample && r.memory_bytes < best->memory_bytes))
+            best = &r;
+    }
+
+    if (!best) {
+        fprintf(stderr, "No configuration meets the targets.\n");
+        return 2;
+    }
+
+    fprintf(text, "\nCheapest configuration meeting the targets: size %u, ref rate %g, %s\n",
+            best->config.table_size, best->config.ref_sample_rate, interpolation_name(best->config.interpolation));
+    return 0;
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Measures the registry of shared multisamples: the lock-free lookup of a
+// key, and the loading of one wave by many instances, whose label compares
+// the memory of the shared tables with that of a copy per instance.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+#include "sfizz/WavetableRegistry.h"
+#include <cstdio>
+
+using sfz::WavetableMulti;
+using sfz::WavetableRegistry;
+
+static constexpr unsigned tableSize = 2048;
+static constexpr unsigned numLookups = 1024;
+
+static size_t tableMemory(const WavetableMulti& wave)
+{
+    return WavetableMulti::numTables() * wave.tableStride() * sizeof(float);
+}
+
+static void RegistryFind(bench::State& state)
+{
+    WavetableRegistry registry;
+    const std::vector<float> wave = bench::sawtoothWave(tableSize);
+    WavetableRegistry::Pointer held = registry.getFromAudioData(wave, 1.0, tableSize);
+    const WavetableRegistry::Key key = WavetableRegistry::getAudioDataKey(wave, 1.0, tableSize);
+
+    while (state.keepRunning()) {
+        for (unsigned i = 0; i < numLookups; ++i) {
+            WavetableRegistry::Pointer found = registry.find(key);
+            bench::doNotOptimize(found.get());
+        }
+    }
+
+    state.setItemsProcessed(state.iterations() * numLookups);
+}
+
+static void RegistryInstances(bench::State& state)
+{
+    const unsigned numInstances = static_cast<unsigned>(state.arg());
+    const std::vector<float> wave = bench::sawtoothWave(tableSize);
+
+    size_t shared = 0;
+    while (state.keepRunning()) {
+        WavetableRegistry registry;
+        std::vector<WavetableRegistry::Pointer> instances;
+        for (unsigned i = 0; i < numInstances; ++i)
+            instances.push_back(registry.getFromAudioData(wave, 1.0, tableSize));
+        shared = registry.size();
+        bench::doNotOptimize(instances.data());
+    }
+
+    const size_t memory = tableMemory(WavetableMulti::createFromAudioData(wave, 1.0, tableSize));
+    state.setItemsProcessed(state.iterations() * numInstances);
+    char label[96];
+    snprintf(label, sizeof(label), "%zu shared, %zu KiB instead of %zu KiB",
+        shared, shared * memory / 1024, numInstances * memory / 1024);
+    state.setLabel(label);
+}
+
+BENCHMARK(RegistryFind);
+BENCHMARK_ARGS(RegistryInstances, 1, 32);
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Measures the render rate of the oscillator, for each interpolation, at
+// table sizes with a specialized reader and at a size without one.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+
+using sfz::WavetableMulti;
+using sfz::WavetableOscillator;
+using sfz::WavetableInterpolation;
+
+static constexpr unsigned blockSize = 256;
+static constexpr unsigned numBlocks = 64;
+
+static bool hasSpecializedReader(unsigned tableSize)
+{
+    return tableSize >= 256 && tableSize <= 8192 && (tableSize & (tableSize - 1)) == 0;
+}
+
+static void render(bench::State& state, WavetableInterpolation interpolation, bool modulated)
+{
+    const unsigned tableSize = static_cast<unsigned>(state.arg());
+    const WavetableMulti wm = bench::sawtoothWavetable(tableSize);
+
+    WavetableOscillator osc;
+    osc.init(bench::sampleRate);
+    osc.setWavetable(&wm);
+    osc.setInterpolation(interpolation);
+
+    const std::vector<float> freqs = bench::frequencySweep(20.0f, 20000.0f, blockSize * numBlocks);
+    std::vector<float> output(blockSize);
+
+    while (state.keepRunning()) {
+        for (unsigned b = 0; b < numBlocks; ++b) {
+            if (modulated)
+                osc.processModulated(&freqs[b * blockSize], output.data(), blockSize);
+            else
+                osc.process(freqs[b * blockSize], output.data(), blockSize);
+            bench::doNotOptimize(output.data());
+        }
+    }
+
+    state.setItemsProcessed(state.iterations() * numBlocks * blockSize);
+    state.setLabel(hasSpecializedReader(tableSize) ? "specialized" : "generic");
+}
+
+static void RenderLinear(bench::State& state)
+{
+    render(state, WavetableInterpolation::Linear, false);
+}
+
+static void RenderCubic(bench::State& state)
+{
+    render(state, WavetableInterpolation::Cubic, false);
+}
+
+static void RenderModulatedLinear(bench::State& state)
+{
+    render(state, WavetableInterpolation::Linear, true);
+}
+
+BENCHMARK_ARGS(RenderLinear, 256, 2000, 2048, 8192, 65536);
+BENCHMARK_ARGS(RenderCubic, 256, 2000, 2048, 8192, 65536);
+BENCHMARK_ARGS(RenderModulatedLinear, 2048);
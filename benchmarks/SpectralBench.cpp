@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Measures the spectral oscillator with modifiers which change at every
+// block: the time of the audio thread per block, at the 99th percentile and
+// at worst, and the latency of the worker, in blocks of audio played in real
+// time until all the tables which play have the new modifiers. The worst
+// block includes the preemptions of the audio thread by the worker, when
+// they share a core.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+#include "sfizz/SpectralOscillator.h"
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+
+using sfz::SpectralModifiers;
+using sfz::SpectralOscillator;
+
+static constexpr unsigned numBlocks = 64;
+static constexpr float frequency = 220.0f;
+
+// a slow sweep of the tilt and of the highest harmonic
+static SpectralModifiers modulatedModifiers(unsigned block)
+{
+    const float lfo = std::sin(block * 0.05f);
+    SpectralModifiers modifiers;
+    modifiers.tilt = -6.0f + 3.0f * lfo;
+    modifiers.highestHarmonic = 40.0f + 30.0f * lfo;
+    return modifiers;
+}
+
+static void SpectralProcess(bench::State& state)
+{
+    const unsigned blockSize = static_cast<unsigned>(state.arg());
+
+    SpectralOscillator osc;
+    osc.init(bench::sampleRate);
+    osc.setProfile(bench::SawtoothProfile());
+
+    typedef std::chrono::steady_clock clock;
+    std::vector<float> output(blockSize);
+    std::vector<double> durations;
+    unsigned block = 0;
+
+    while (state.keepRunning()) {
+        for (unsigned b = 0; b < numBlocks; ++b, ++block) {
+            clock::time_point start = clock::now();
+            osc.setModifiers(modulatedModifiers(block));
+            osc.process(frequency, output.data(), blockSize);
+            std::chrono::duration<double> duration = clock::now() - start;
+            durations.push_back(duration.count());
+            bench::doNotOptimize(output.data());
+        }
+    }
+
+    state.setItemsProcessed(state.iterations() * numBlocks * blockSize);
+    std::sort(durations.begin(), durations.end());
+    const double p99 = durations[(durations.size() * 99 + 99) / 100 - 1];
+    char label[96];
+    snprintf(label, sizeof(label), "block p99 %.1f us, worst %.1f us of %.0f us",
+        p99 * 1e6, durations.back() * 1e6, blockSize / bench::sampleRate * 1e6);
+    state.setLabel(label);
+}
+
+static void SpectralUpdateLatency(bench::State& state)
+{
+    const unsigned blockSize = static_cast<unsigned>(state.arg());
+
+    SpectralOscillator osc;
+    osc.init(bench::sampleRate);
+    osc.setProfile(bench::SawtoothProfile());
+
+    // the blocks are played at the pace of a real-time audio callback
+    typedef std::chrono::steady_clock clock;
+    const std::chrono::duration<double> blockDuration(blockSize / bench::sampleRate);
+    std::vector<float> output(blockSize);
+    std::vector<unsigned> latencies;
+    unsigned block = 0;
+
+    while (state.keepRunning()) {
+        osc.setModifiers(modulatedModifiers(++block));
+        unsigned latency = 0;
+        clock::time_point deadline = clock::now();
+        do {
+            osc.process(frequency, output.data(), blockSize);
+            bench::doNotOptimize(output.data());
+            ++latency;
+            deadline += std::chrono::duration_cast<clock::duration>(blockDuration);
+            std::this_thread::sleep_until(deadline);
+        } while (osc.playingVersion() != osc.requestedVersion());
+        latencies.push_back(latency);
+    }
+
+    state.setItemsProcessed(state.iterations());
+    std::sort(latencies.begin(), latencies.end());
+    const unsigned p99 = latencies[(latencies.size() * 99 + 99) / 100 - 1];
+    char label[64];
+    snprintf(label, sizeof(label), "latency p99 %u blocks, max %u blocks", p99, latencies.back());
+    state.setLabel(label);
+}
+
+BENCHMARK_ARGS(SpectralProcess, 64, 256);
+BENCHMARK_ARGS(SpectralUpdateLatency, 64, 256);
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Compares the unison renderer, which processes the voices as SIMD lanes,
+// with independent oscillators; the label is the number of voices which one
+// core renders in real time.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+#include "sfizz/WavetableUnison.h"
+#include <cstdio>
+
+using sfz::WavetableMulti;
+using sfz::WavetableOscillator;
+using sfz::WavetableUnison;
+
+static constexpr unsigned blockSize = 256;
+static constexpr unsigned numBlocks = 64;
+static constexpr float frequency = 220.0f;
+static constexpr float detune = 25.0f;
+
+static std::string voicesPerCore(bench::State& state, unsigned numVoices)
+{
+    double frames = static_cast<double>(state.iterations()) * numBlocks * blockSize;
+    double realTime = frames / bench::sampleRate;
+    char label[64];
+    snprintf(label, sizeof(label), "%.0f voices/core", numVoices * realTime / state.elapsedSeconds());
+    return label;
+}
+
+static void UnisonIndependent(bench::State& state)
+{
+    const unsigned numVoices = static_cast<unsigned>(state.arg());
+    const WavetableMulti wm = bench::sawtoothWavetable(2048);
+
+    std::vector<WavetableOscillator> oscs(numVoices);
+    std::vector<float> freqs(numVoices);
+    for (unsigned v = 0; v < numVoices; ++v) {
+        float spread = (numVoices > 1) ? (2.0f * v / (numVoices - 1) - 1.0f) : 0.0f;
+        freqs[v] = frequency * std::exp2(spread * detune / 1200.0f);
+        oscs[v].init(bench::sampleRate);
+        oscs[v].setWavetable(&wm);
+    }
+
+    std::vector<float> voice(blockSize);
+    std::vector<float> mix(blockSize);
+    while (state.keepRunning()) {
+        for (unsigned b = 0; b < numBlocks; ++b) {
+            std::fill(mix.begin(), mix.end(), 0.0f);
+            for (unsigned v = 0; v < numVoices; ++v) {
+                oscs[v].process(freqs[v], voice.data(), blockSize);
+                for (unsigned i = 0; i < blockSize; ++i)
+                    mix[i] += voice[i];
+            }
+            bench::doNotOptimize(mix.data());
+        }
+    }
+
+    state.setItemsProcessed(state.iterations() * numBlocks * blockSize * numVoices);
+    state.setLabel(voicesPerCore(state, numVoices));
+}
+
+static void UnisonSIMD(bench::State& state)
+{
+    const unsigned numVoices = static_cast<unsigned>(state.arg());
+    const WavetableMulti wm = bench::sawtoothWavetable(2048);
+
+    WavetableUnison unison;
+    unison.init(bench::sampleRate);
+    unison.setWavetable(&wm);
+    unison.setVoices(numVoices, detune);
+
+    std::vector<float> mix(blockSize);
+    while (state.keepRunning()) {
+        for (unsigned b = 0; b < numBlocks; ++b) {
+            unison.process(frequency, mix.data(), blockSize);
+            bench::doNotOptimize(mix.data());
+        }
+    }
+
+    state.setItemsProcessed(state.iterations() * numBlocks * blockSize * numVoices);
+    state.setLabel(voicesPerCore(state, numVoices));
+}
+
+BENCHMARK_ARGS(UnisonIndependent, 1, 4, 7, 16);
+BENCHMARK_ARGS(UnisonSIMD, 1, 4, 7, 16);
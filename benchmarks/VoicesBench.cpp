@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Compares the kernels which mix a bank of voices, each at its own frequency;
+// the kernels which the processor does not support are skipped.
+
+#include "Bench.h"
+#include "BenchUtility.h"
+#include "sfizz/WavetableVoices.h"
+#include <cmath>
+
+using sfz::WavetableMulti;
+using sfz::WavetableVoices;
+using sfz::VoiceKernel;
+
+static constexpr unsigned blockSize = 256;
+
+static void mixVoices(bench::State& state, VoiceKernel kernel)
+{
+    if (!sfz::isVoiceKernelSupported(kernel)) {
+        state.setLabel("unsupported");
+        while (state.keepRunning())
+            ;
+        return;
+    }
+
+    const unsigned numVoices = static_cast<unsigned>(state.arg());
+    const WavetableMulti wm = bench::sawtoothWavetable(2048);
+
+    WavetableVoices voices;
+    voices.init(bench::sampleRate, numVoices);
+    voices.setWavetable(&wm);
+    voices.setKernel(kernel);
+
+    // spread the voices over 5 octaves, with phases apart
+    for (unsigned v = 0; v < numVoices; ++v) {
+        float frequency = 55.0f * std::exp2(5.0f * v / numVoices);
+        voices.setVoice(v, frequency, 1.0f / numVoices);
+        float phase = v * 0.618034f;
+        voices.setVoicePhase(v, phase - std::floor(phase));
+    }
+
+    std::vector<float> mix(blockSize);
+    while (state.keepRunning()) {
+        voices.process(mix.data(), blockSize);
+        bench::doNotOptimize(mix.data());
+    }
+
+    state.setItemsProcessed(state.iterations() * blockSize * numVoices);
+    state.setLabel(sfz::voiceKernelName(kernel));
+}
+
+static void VoicesScalar(bench::State& state)
+{
+    mixVoices(state, VoiceKernel::Scalar);
+}
+
+static void VoicesSSE2(bench::State& state)
+{
+    mixVoices(state, VoiceKernel::SSE2);
+}
+
+static void VoicesAVX2(bench::State& state)
+{
+    mixVoices(state, VoiceKernel::AVX2);
+}
+
+BENCHMARK_ARGS(VoicesScalar, 32, 128, 512);
+BENCHMARK_ARGS(VoicesSSE2, 32, 128, 512);
+BENCHMARK_ARGS(VoicesAVX2, 32, 128, 512);
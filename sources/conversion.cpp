@@ -0,0 +1,696 @@
+#include "conversion.h"
+#include "conversion_cache.h"
+#include "conversion_stats.h"
+#include "spectral_morph.h"
+#include "dr_wav_library.h"
+#include "sfizz/Wavetables.h"
+#include <nonstd/scope.hpp>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+#include <dirent.h>
+
+int read_file_waveform(const char *path, Waveform &wave)
+{
+    drwav wav_file;
+    drwav_bool32 wav_init = drwav_init_file(&wav_file, path, nullptr);
+
+    if (!wav_init) {
+        fprintf(stderr, "Cannot open sound file.\n");
+        return 1;
+    }
+    auto wav_file_cleanup = nonstd::make_scope_exit(
+        [&wav_file]() { drwav_uninit(&wav_file); });
+
+    if (wav_file.channels < 1) {
+        fprintf(stderr, "Sound data does not contain any channels.\n");
+        return 1;
+    }
+    const uint32_t channels = wav_file.channels;
+    if (wav_file.totalPCMFrameCount > SIZE_MAX / sizeof(float) / channels) {
+        fprintf(stderr, "Sound data is too large.\n");
+        return 1;
+    }
+    if (wav_file.totalPCMFrameCount < 4) {
+        fprintf(stderr, "Sound data is too small.\n");
+        return 1;
+    }
+
+    const size_t frames = (size_t)wav_file.totalPCMFrameCount;
+    wave.size = frames;
+    wave.channels = channels;
+    wave.data.reset(new float[frames * channels]);
+
+    if (channels == 1) {
+        if (drwav_read_pcm_frames_f32(&wav_file, frames, wave.data.get()) != frames) {
+            fprintf(stderr, "Cannot read sound data.\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    // separate the channels by blocks, in a single pass over the frames
+    constexpr size_t block_frames = 1024;
+    std::unique_ptr<float[]> block(new float[block_frames * channels]);
+
+    for (size_t offset = 0; offset < frames;) {
+        size_t count = std::min(block_frames, frames - offset);
+        if (drwav_read_pcm_frames_f32(&wav_file, count, block.get()) != count) {
+            fprintf(stderr, "Cannot read sound data.\n");
+            return 1;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const float *frame = &block[i * channels];
+            for (uint32_t c = 0; c < channels; ++c)
+                wave.data[c * frames + offset + i] = frame[c];
+        }
+        offset += count;
+    }
+
+    return 0;
+}
+
+// the smallest of the automatic table sizes; below, the error of the linear
+// interpolation becomes audible, and the readers are not specialized.
+static constexpr uint32_t auto_size_min = 256;
+
+TableSizeChoice choose_table_size(const std::vector<nonstd::span<const float>> &waves, const ConversionOptions &options)
+{
+    const uint32_t max_size = options.table_size;
+    const double threshold = std::pow(10.0, options.auto_size_threshold_db / 10.0);
+
+    // the spectra at the largest size, with the energy of each harmonic
+    std::vector<std::vector<double>> energies(waves.size());
+    uint32_t required = 0;
+    for (size_t w = 0; w < waves.size(); ++w) {
+        const std::vector<std::complex<float>> spectrum =
+            sfz::WavetableMulti::analyzeAudioData(waves[w], max_size, options.cycles);
+
+        std::vector<double> &energy = energies[w];
+        energy.resize(spectrum.size());
+        double total = 0;
+        for (size_t k = 1; k < spectrum.size(); ++k)
+            total += energy[k] = std::norm(spectrum[k]);
+
+        // a harmonic k is kept by tables of more than 2k elements; at 2k,
+        // it falls on the Nyquist bin, which keeps only its real part
+        for (size_t k = spectrum.size(); k-- > 1;) {
+            if (energy[k] > threshold * total) {
+                required = std::max(required, (uint32_t)(2 * k + 1));
+                break;
+            }
+        }
+    }
+
+    TableSizeChoice choice;
+    choice.table_size = max_size;
+    for (uint32_t size = auto_size_min; size < max_size; size *= 2) {
+        if (size >= required) {
+            choice.table_size = size;
+            break;
+        }
+    }
+
+    double error = 0;
+    for (const std::vector<double> &energy : energies) {
+        double total = 0, discarded = 0;
+        for (size_t k = 1; k < energy.size(); ++k) {
+            total += energy[k];
+            if (k >= choice.table_size / 2)
+                discarded += energy[k];
+        }
+        if (total > 0)
+            error = std::max(error, discarded / total);
+    }
+    choice.error_db = (error > 1e-20) ? (10.0 * std::log10(error)) : -200.0;
+
+    return choice;
+}
+
+void apply_auto_size(const std::vector<nonstd::span<const float>> &waves, const char *name, ConversionOptions &options)
+{
+    if (!options.auto_size)
+        return;
+
+    TableSizeChoice choice = choose_table_size(waves, options);
+    options.table_size = choice.table_size;
+    fprintf(stderr, "%s: table size %u, error %.1f dB\n", name, choice.table_size, choice.error_db);
+}
+
+void apply_auto_size(const Waveform &wave, const char *name, ConversionOptions &options)
+{
+    std::vector<nonstd::span<const float>> channels(wave.channels);
+    for (uint32_t c = 0; c < wave.channels; ++c)
+        channels[c] = wave.channel(c);
+    apply_auto_size(channels, name, options);
+}
+
+bool convert_waveform(nonstd::span<const float> wave, const ConversionOptions &options, FILE *output, ConversionStats *stats)
+{
+    double write_ms = 0;
+
+    // generate and write the tables one at a time
+    StatsTimer begin_timer;
+    std::unique_ptr<MipmapWriter> writer = create_mipmap_writer(options.format, output);
+    if (!writer->begin(options.table_size))
+        return false;
+    write_ms += begin_timer.elapsed_ms();
+
+    StatsTimer analysis_timer;
+    const std::vector<std::complex<float>> spectrum =
+        sfz::WavetableMulti::analyzeAudioData(wave, options.table_size, options.cycles);
+    const double analysis_ms = analysis_timer.elapsed_ms();
+
+    // the writer is timed apart, and the rest is the synthesis of the tables
+    double table_write_ms = 0;
+    StatsTimer synthesis_timer;
+    sfz::WavetableMulti::generateForHarmonicProfile(
+        sfz::TabulatedHarmonicProfile { spectrum },
+        [&writer, &table_write_ms](unsigned table_no, nonstd::span<const float> table) {
+            StatsTimer write_timer;
+            writer->write_table(table_no, table);
+            table_write_ms += write_timer.elapsed_ms();
+        },
+        options.amplitude, options.table_size, options.ref_sample_rate);
+    const double synthesis_ms = synthesis_timer.elapsed_ms() - table_write_ms;
+    write_ms += table_write_ms;
+
+    StatsTimer end_timer;
+    writer->end();
+    write_ms += end_timer.elapsed_ms();
+
+    if (stats) {
+        stats->analysis_ms += analysis_ms;
+        stats->analysis_cpu_ms += analysis_ms;
+        stats->synthesis_ms += synthesis_ms;
+        stats->synthesis_cpu_ms += synthesis_ms;
+        stats->write_ms += write_ms;
+    }
+    return true;
+}
+
+// the spectrum of an entry of a set of mipmaps, identified by its index
+typedef std::function<std::vector<std::complex<float>>(uint32_t)> SpectrumSource;
+
+// the time during which a thread ran a stage for an entry, in milliseconds
+// from a common origin
+struct StageInterval {
+    double begin = 0;
+    double end = 0;
+};
+
+// add the times of a stage which ran on several threads: the wall time,
+// during which at least one thread ran it, and the sum of the times of the
+// threads
+static void add_stage_times(std::vector<StageInterval> intervals, double &wall_ms, double &cpu_ms)
+{
+    std::sort(intervals.begin(), intervals.end(),
+              [](const StageInterval &a, const StageInterval &b) { return a.begin < b.begin; });
+
+    double reached = 0;
+    for (const StageInterval &interval : intervals) {
+        // the stage of an entry which failed may not have ended
+        if (interval.end < interval.begin)
+            continue;
+        cpu_ms += interval.end - interval.begin;
+        double begin = std::max(interval.begin, reached);
+        if (interval.end > begin) {
+            wall_ms += interval.end - begin;
+            reached = interval.end;
+        }
+    }
+}
+
+// create mipmaps from the spectra of a source on a pool of threads; the
+// time of the source counts as analysis
+static bool create_mipmaps_parallel(uint32_t count, const SpectrumSource &source,
+                                    const ConversionOptions &options, std::vector<sfz::WavetableMulti> &mipmaps,
+                                    ConversionStats *stats)
+{
+    typedef sfz::WavetableMulti::CreationStage CreationStage;
+
+    mipmaps.clear();
+    mipmaps.resize(count);
+
+    // the intervals of the stages of each entry
+    std::vector<StageInterval> analysis(count), synthesis(count), fill_extra(count);
+    const StatsTimer origin;
+
+    // each thread takes the next entry, until all are done
+    std::atomic<uint32_t> next_entry { 0 };
+    std::atomic<bool> failed { false };
+    auto work = [&]() {
+        for (uint32_t i; (i = next_entry++) < count;) {
+            try {
+                analysis[i].begin = origin.elapsed_ms();
+                const std::vector<std::complex<float>> spectrum = source(i);
+                analysis[i].end = origin.elapsed_ms();
+
+                sfz::WavetableMulti::StageCallback on_stage;
+                if (stats) {
+                    on_stage = [&, i](CreationStage stage) {
+                        const double now = origin.elapsed_ms();
+                        switch (stage) {
+                        case CreationStage::Synthesis:
+                            synthesis[i].begin = now;
+                            break;
+                        case CreationStage::FillExtra:
+                            synthesis[i].end = now;
+                            fill_extra[i].begin = now;
+                            break;
+                        case CreationStage::Done:
+                            fill_extra[i].end = now;
+                            break;
+                        }
+                    };
+                }
+
+                mipmaps[i] = sfz::WavetableMulti::createForHarmonicProfile(
+                    sfz::TabulatedHarmonicProfile { spectrum }, options.amplitude,
+                    options.table_size, options.ref_sample_rate, on_stage);
+            }
+            catch (std::exception &) {
+                failed = true;
+            }
+        }
+    };
+
+    unsigned num_threads = std::min(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < num_threads; ++i)
+        threads.emplace_back(work);
+    work();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    if (stats) {
+        add_stage_times(analysis, stats->analysis_ms, stats->analysis_cpu_ms);
+        add_stage_times(synthesis, stats->synthesis_ms, stats->synthesis_cpu_ms);
+        add_stage_times(fill_extra, stats->fill_extra_ms, stats->fill_extra_cpu_ms);
+    }
+
+    return !failed;
+}
+
+// convert waveforms to mipmaps on a pool of threads
+static bool convert_waveforms_parallel(const std::vector<nonstd::span<const float>> &waves,
+                                       const ConversionOptions &options, std::vector<sfz::WavetableMulti> &mipmaps,
+                                       ConversionStats *stats)
+{
+    auto analyze = [&waves, &options](uint32_t i) {
+        return sfz::WavetableMulti::analyzeAudioData(waves[i], options.table_size, options.cycles);
+    };
+    return create_mipmaps_parallel((uint32_t)waves.size(), analyze, options, mipmaps, stats);
+}
+
+static std::vector<const sfz::WavetableMulti *> mipmap_pointers(const std::vector<sfz::WavetableMulti> &mipmaps)
+{
+    std::vector<const sfz::WavetableMulti *> pointers(mipmaps.size());
+    for (size_t i = 0; i < mipmaps.size(); ++i)
+        pointers[i] = &mipmaps[i];
+    return pointers;
+}
+
+bool convert_multichannel_waveform(const Waveform &wave, const ConversionOptions &options, FILE *output,
+                                   ConversionStats *stats)
+{
+    std::vector<nonstd::span<const float>> channels(wave.channels);
+    for (uint32_t c = 0; c < wave.channels; ++c)
+        channels[c] = wave.channel(c);
+
+    std::vector<sfz::WavetableMulti> parts;
+    if (!convert_waveforms_parallel(channels, options, parts, stats))
+        return false;
+
+    StatsTimer write_timer;
+    bool written = write_mipmap_bank(options.format, output, mipmap_pointers(parts));
+    if (stats)
+        stats->write_ms += write_timer.elapsed_ms();
+
+    return written;
+}
+
+// convert a waveform of any number of channels
+static bool convert_any_waveform(const Waveform &wave, const ConversionOptions &options, FILE *output,
+                                 ConversionStats *stats)
+{
+    if (wave.channels == 1)
+        return convert_waveform(wave.channel(0), options, output, stats);
+    else
+        return convert_multichannel_waveform(wave, options, output, stats);
+}
+
+static bool convert_waveform_cached(const Waveform &wave, const ConversionOptions &options, FILE *output,
+                                    ConversionStats *stats)
+{
+    const char *cache_dir = options.cache_dir.c_str();
+
+    // reuse the output of an identical conversion, or make it an entry;
+    // copying the entry counts as writing
+    uint64_t key = conversion_cache_key(wave, options);
+    StatsTimer fetch_timer;
+    if (conversion_cache_fetch(cache_dir, key, options.format, output)) {
+        if (stats) {
+            stats->cached = true;
+            stats->write_ms += fetch_timer.elapsed_ms();
+        }
+        return true;
+    }
+
+    bool stored = conversion_cache_store(
+        cache_dir, key, options.format,
+        [&wave, &options, stats](FILE *stream) { return convert_any_waveform(wave, options, stream, stats); });
+    if (stored) {
+        StatsTimer copy_timer;
+        bool fetched = conversion_cache_fetch(cache_dir, key, options.format, output);
+        if (stats)
+            stats->write_ms += copy_timer.elapsed_ms();
+        return fetched;
+    }
+
+    fprintf(stderr, "Cannot write the cache entry.\n");
+    return convert_any_waveform(wave, options, output, stats);
+}
+
+// get the position of an output stream, or a negative value if it is not
+// a regular file
+static int64_t output_position(FILE *output)
+{
+    struct stat st;
+    if (fstat(fileno(output), &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+    return (int64_t)ftello(output);
+}
+
+// complete the measures of a conversion, which are taken by the whole
+static void finish_conversion_stats(ConversionStats &stats, const StatsTimer &total_timer,
+                                    uint64_t allocated_start, int64_t output_start, int64_t output_end)
+{
+    stats.total_ms = total_timer.elapsed_ms();
+    stats.allocated_bytes = stats_allocated_bytes() - allocated_start;
+    stats.peak_rss_bytes = stats_peak_rss_bytes();
+    stats.output_bytes = (output_start >= 0 && output_end >= 0) ? (output_end - output_start) : -1;
+}
+
+int run_conversion_job(const ConversionJob &job, const ConversionOptions &job_options, ConversionStats *stats)
+{
+    StatsTimer total_timer;
+    uint64_t allocated_start = stats_allocated_bytes();
+
+    Waveform raw;
+    StatsTimer decode_timer;
+    int ret = read_file_waveform(job.input_path.c_str(), raw);
+    if (ret != 0)
+        return ret;
+    if (stats)
+        stats->decode_ms = decode_timer.elapsed_ms();
+
+    if (raw.size < 2 * (size_t)job_options.cycles) {
+        fprintf(stderr, "Sound data is too small for the number of cycles.\n");
+        return 1;
+    }
+
+    ConversionOptions options = job_options;
+    apply_auto_size(raw, job.input_path.c_str(), options);
+
+    ///
+    FILE *output = stdout;
+    if (!job.output_path.empty()) {
+        output = fopen(job.output_path.c_str(), "wb");
+        if (!output) {
+            fprintf(stderr, "Cannot open output file.\n");
+            return 1;
+        }
+    }
+
+    int64_t output_start = output_position(output);
+
+    bool converted;
+    if (!options.cache_dir.empty())
+        converted = convert_waveform_cached(raw, options, output, stats);
+    else
+        converted = convert_any_waveform(raw, options, output, stats);
+
+    fflush(output);
+    int err = ferror(output);
+    int64_t output_end = output_position(output);
+    if (output != stdout)
+        fclose(output);
+
+    if (!converted || err) {
+        fprintf(stderr, "Cannot write output file.\n");
+        return 1;
+    }
+
+    if (stats)
+        finish_conversion_stats(*stats, total_timer, allocated_start, output_start, output_end);
+
+    return 0;
+}
+
+// write the mipmaps to the output as a packed bank, or to the standard
+// output if there is no path, and complete the measures of the conversion
+static int write_bank_output(const char *output_path, const ConversionOptions &options,
+                             const std::vector<sfz::WavetableMulti> &mipmaps, ConversionStats *stats,
+                             const StatsTimer &total_timer, uint64_t allocated_start)
+{
+    FILE *output = stdout;
+    if (output_path) {
+        output = fopen(output_path, "wb");
+        if (!output) {
+            fprintf(stderr, "Cannot open output file.\n");
+            return 1;
+        }
+    }
+
+    int64_t output_start = output_position(output);
+
+    StatsTimer write_timer;
+    bool written = write_mipmap_bank(options.format, output, mipmap_pointers(mipmaps), BankLayout::Packed);
+
+    fflush(output);
+    int err = ferror(output);
+    int64_t output_end = output_position(output);
+    if (stats)
+        stats->write_ms += write_timer.elapsed_ms();
+    if (output != stdout)
+        fclose(output);
+
+    if (!written || err) {
+        fprintf(stderr, "Cannot write output file.\n");
+        return 1;
+    }
+
+    if (stats)
+        finish_conversion_stats(*stats, total_timer, allocated_start, output_start, output_end);
+
+    return 0;
+}
+
+int run_bank_conversion(const std::vector<std::string> &inputs, const char *output_path, const ConversionOptions &bank_options,
+                        ConversionStats *stats)
+{
+    StatsTimer total_timer;
+    uint64_t allocated_start = stats_allocated_bytes();
+
+    ConversionOptions options = bank_options;
+
+    std::vector<std::string> files;
+    if (!collect_input_files(inputs, files))
+        return 1;
+
+    // each channel of each file is an entry of the bank, in order
+    std::vector<Waveform> raws(files.size());
+    std::vector<nonstd::span<const float>> waves;
+    for (size_t i = 0; i < files.size(); ++i) {
+        Waveform &raw = raws[i];
+        StatsTimer decode_timer;
+        int ret = read_file_waveform(files[i].c_str(), raw);
+        if (ret != 0) {
+            fprintf(stderr, "Cannot convert: %s\n", files[i].c_str());
+            return ret;
+        }
+        if (stats)
+            stats->decode_ms += decode_timer.elapsed_ms();
+        if (raw.size < 2 * (size_t)options.cycles) {
+            fprintf(stderr, "Sound data is too small for the number of cycles: %s\n", files[i].c_str());
+            return 1;
+        }
+        for (uint32_t c = 0; c < raw.channels; ++c)
+            waves.push_back(raw.channel(c));
+    }
+
+    if (waves.empty()) {
+        fprintf(stderr, "There are no sound files to put in the bank.\n");
+        return 1;
+    }
+
+    // the entries of a bank have a common size
+    apply_auto_size(waves, output_path ? output_path : "bank", options);
+
+    std::vector<sfz::WavetableMulti> mipmaps;
+    if (!convert_waveforms_parallel(waves, options, mipmaps, stats)) {
+        fprintf(stderr, "Cannot convert the bank.\n");
+        return 1;
+    }
+    raws.clear();
+
+    return write_bank_output(output_path, options, mipmaps, stats, total_timer, allocated_start);
+}
+
+int run_morph_conversion(const std::vector<std::string> &inputs, const char *output_path, uint32_t num_frames,
+                         const ConversionOptions &morph_options, ConversionStats *stats)
+{
+    StatsTimer total_timer;
+    uint64_t allocated_start = stats_allocated_bytes();
+
+    ConversionOptions options = morph_options;
+
+    Waveform raws[2];
+    for (unsigned i = 0; i < 2; ++i) {
+        StatsTimer decode_timer;
+        int ret = read_file_waveform(inputs[i].c_str(), raws[i]);
+        if (ret != 0) {
+            fprintf(stderr, "Cannot convert: %s\n", inputs[i].c_str());
+            return ret;
+        }
+        if (stats)
+            stats->decode_ms += decode_timer.elapsed_ms();
+        if (raws[i].channels != 1) {
+            fprintf(stderr, "The morph takes sound files of a single channel: %s\n", inputs[i].c_str());
+            return 1;
+        }
+        if (raws[i].size < 2 * (size_t)options.cycles) {
+            fprintf(stderr, "Sound data is too small for the number of cycles: %s\n", inputs[i].c_str());
+            return 1;
+        }
+    }
+
+    // the frames have a common size, which keeps the harmonics of both
+    apply_auto_size({ raws[0].channel(0), raws[1].channel(0) }, output_path ? output_path : "morph", options);
+
+    StatsTimer analysis_timer;
+    const SpectralMorph morph(
+        sfz::WavetableMulti::analyzeAudioData(raws[0].channel(0), options.table_size, options.cycles),
+        sfz::WavetableMulti::analyzeAudioData(raws[1].channel(0), options.table_size, options.cycles));
+    if (stats) {
+        const double analysis_ms = analysis_timer.elapsed_ms();
+        stats->analysis_ms += analysis_ms;
+        stats->analysis_cpu_ms += analysis_ms;
+    }
+
+    // the frames go from the first input to the second, inclusive
+    auto interpolate = [&morph, num_frames](uint32_t i) {
+        return morph.interpolate((float)i / (num_frames - 1));
+    };
+
+    std::vector<sfz::WavetableMulti> mipmaps;
+    if (!create_mipmaps_parallel(num_frames, interpolate, options, mipmaps, stats)) {
+        fprintf(stderr, "Cannot convert the morph.\n");
+        return 1;
+    }
+
+    return write_bank_output(output_path, options, mipmaps, stats, total_timer, allocated_start);
+}
+
+//------------------------------------------------------------------------------
+bool is_directory(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool is_wave_file_name(const std::string &name)
+{
+    size_t length = name.size();
+    return length > 4 && name[0] != '.' && strcasecmp(&name[length - 4], ".wav") == 0;
+}
+
+bool is_batch_conversion(const std::vector<std::string> &inputs)
+{
+    return inputs.size() > 1 ||
+        std::any_of(inputs.begin(), inputs.end(), [](const std::string &path) { return is_directory(path); });
+}
+
+std::string batch_output_path(const std::string &input_path, const std::string &output_dir, OutputFormat format)
+{
+    size_t name_start = input_path.rfind('/');
+    name_start = (name_start == std::string::npos) ? 0 : (name_start + 1);
+    size_t name_end = input_path.rfind('.');
+    if (name_end == std::string::npos || name_end < name_start)
+        name_end = input_path.size();
+
+    return output_dir + '/' + input_path.substr(name_start, name_end - name_start) +
+        '.' + output_format_extension(format);
+}
+
+static bool list_wave_files(const std::string &dir_path, std::vector<std::string> &files)
+{
+    DIR *dir = opendir(dir_path.c_str());
+    if (!dir)
+        return false;
+
+    std::vector<std::string> names;
+    while (dirent *ent = readdir(dir)) {
+        std::string name = ent->d_name;
+        if (is_wave_file_name(name))
+            names.push_back(std::move(name));
+    }
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    for (const std::string &name : names)
+        files.push_back(dir_path + '/' + name);
+    return true;
+}
+
+bool collect_input_files(const std::vector<std::string> &inputs, std::vector<std::string> &files)
+{
+    for (const std::string &input : inputs) {
+        if (!is_directory(input))
+            files.push_back(input);
+        else if (!list_wave_files(input, files)) {
+            fprintf(stderr, "Cannot read the input directory: %s\n", input.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool collect_conversion_jobs(const std::vector<std::string> &inputs, const char *output,
+                             OutputFormat format, std::vector<ConversionJob> &jobs)
+{
+    if (!is_batch_conversion(inputs)) {
+        ConversionJob job;
+        job.input_path = inputs[0];
+        job.output_path = output ? output : "";
+        jobs.push_back(std::move(job));
+        return true;
+    }
+
+    if (!output) {
+        fprintf(stderr, "An output directory is required for several inputs.\n");
+        return false;
+    }
+    if (mkdir(output, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Cannot create the output directory.\n");
+        return false;
+    }
+
+    std::vector<std::string> files;
+    if (!collect_input_files(inputs, files))
+        return false;
+
+    for (const std::string &file : files) {
+        ConversionJob job;
+        job.input_path = file;
+        job.output_path = batch_output_path(file, output, format);
+        jobs.push_back(std::move(job));
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "mipmap_output.h"
+#include "conversion_stats.h"
+#include <nonstd/span.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+struct Waveform {
+    // the samples of each channel, one channel after another
+    std::unique_ptr<float[]> data;
+    size_t size = 0;
+    uint32_t channels = 0;
+    explicit operator bool() const noexcept { return data != nullptr; }
+
+    nonstd::span<const float> channel(uint32_t c) const
+    {
+        return nonstd::span<const float>(data.get() + c * size, size);
+    }
+};
+
+struct ConversionOptions {
+    OutputFormat format = OutputFormat::Faust;
+    uint32_t table_size = 2048;
+    uint32_t cycles = 1;
+    double amplitude = 1.0;
+    double ref_sample_rate = 44100.0;
+    // choose the table size from the spectrum, up to `table_size`, keeping
+    // the harmonics whose energy is above the threshold
+    bool auto_size = false;
+    double auto_size_threshold_db = -60.0;
+    // directory of the conversion cache, which does not affect the output
+    std::string cache_dir;
+};
+
+struct ConversionJob {
+    std::string input_path;
+    // the output file, or empty for the standard output
+    std::string output_path;
+};
+
+struct TableSizeChoice {
+    uint32_t table_size = 0;
+    // energy of the discarded harmonics relative to the total, in dB, for
+    // the waveform which loses the most
+    double error_db = 0;
+};
+
+// read a sound file, with its channels separated
+int read_file_waveform(const char *path, Waveform &wave);
+
+// choose the smallest table size which is a power of 2, from 256 up to the
+// table size of the options, which keeps every harmonic of the waveforms
+// whose energy relative to the total is above the threshold of the options
+TableSizeChoice choose_table_size(const std::vector<nonstd::span<const float>> &waves, const ConversionOptions &options);
+
+// if the options have the automatic size, choose the size for the
+// waveforms, which are the input of the given name, and print it
+void apply_auto_size(const std::vector<nonstd::span<const float>> &waves, const char *name, ConversionOptions &options);
+void apply_auto_size(const Waveform &wave, const char *name, ConversionOptions &options);
+
+// convert a waveform to a mipmap, writing the tables as they are generated;
+// the functions of conversion add the times of their stages to the stats,
+// if not null
+bool convert_waveform(nonstd::span<const float> wave, const ConversionOptions &options, FILE *output,
+                      ConversionStats *stats = nullptr);
+
+// convert each channel of a waveform to a mipmap in parallel, and write
+// the mipmaps as a bank
+bool convert_multichannel_waveform(const Waveform &wave, const ConversionOptions &options, FILE *output,
+                                   ConversionStats *stats = nullptr);
+
+// read the input of a job, and convert it to the output, using the cache if
+// there is one; print a message and return non-zero on failure
+int run_conversion_job(const ConversionJob &job, const ConversionOptions &options,
+                       ConversionStats *stats = nullptr);
+
+// convert all the inputs, which are files or directories of sound files, to
+// a single output which packs the mipmaps in a bank; the entries of the bank
+// are the channels of the files, in order.
+int run_bank_conversion(const std::vector<std::string> &inputs, const char *output_path, const ConversionOptions &options,
+                        ConversionStats *stats = nullptr);
+
+// morph between two sound files in the spectral domain, and write the
+// frames of the morph as entries of a packed bank, the first and the last
+// being the inputs; the number of frames is at least 2.
+int run_morph_conversion(const std::vector<std::string> &inputs, const char *output_path, uint32_t num_frames,
+                         const ConversionOptions &options, ConversionStats *stats = nullptr);
+
+// whether the inputs are converted in batch, to files of an output directory
+bool is_batch_conversion(const std::vector<std::string> &inputs);
+
+// get the file of the output directory which receives the given input
+std::string batch_output_path(const std::string &input_path, const std::string &output_dir, OutputFormat format);
+
+// get the sound files of the inputs, expanding the directories
+bool collect_input_files(const std::vector<std::string> &inputs, std::vector<std::string> &files);
+
+// get the jobs for the given inputs, which are files or directories of
+// sound files, and the output, which is a directory if in batch
+bool collect_conversion_jobs(const std::vector<std::string> &inputs, const char *output,
+                             OutputFormat format, std::vector<ConversionJob> &jobs);
+
+// helpers of the file system
+bool is_directory(const std::string &path);
+bool is_wave_file_name(const std::string &name);
@@ -0,0 +1,107 @@
+#include "conversion_cache.h"
+#include "sfizz/Wavetables.h"
+#include "sfizz/Hash.h"
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MAKE_WAVETABLE_VERSION
+#define MAKE_WAVETABLE_VERSION "unknown"
+#endif
+
+// increment when the generated output changes for identical inputs
+static constexpr uint32_t cache_format_version = 2;
+
+uint64_t conversion_cache_key(const Waveform &wave, const ConversionOptions &options)
+{
+    sfz::Hasher hasher;
+
+    const char version[] = MAKE_WAVETABLE_VERSION;
+    hasher.update(version, sizeof(version));
+    hasher.update(cache_format_version);
+
+    hasher.update(static_cast<uint64_t>(wave.size));
+    hasher.update(wave.channels);
+    hasher.update(wave.data.get(), wave.size * wave.channels * sizeof(float));
+
+    hasher.update(static_cast<uint32_t>(options.format));
+    hasher.update(options.table_size);
+    hasher.update(options.cycles);
+    hasher.update(options.amplitude);
+    hasher.update(options.ref_sample_rate);
+
+    // mipmap geometry
+    hasher.update(sfz::MipmapRange::N);
+    hasher.update(sfz::MipmapRange::F1);
+    hasher.update(sfz::MipmapRange::FN);
+
+    return hasher.digest();
+}
+
+static std::string cache_entry_path(const char *cache_dir, uint64_t key, OutputFormat format)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx.%s", (unsigned long long)key, output_format_extension(format));
+    return std::string(cache_dir) + name;
+}
+
+bool conversion_cache_fetch(const char *cache_dir, uint64_t key, OutputFormat format, FILE *output)
+{
+    std::string path = cache_entry_path(cache_dir, key, format);
+
+    FILE *entry = fopen(path.c_str(), "rb");
+    if (!entry)
+        return false;
+
+    // write errors are left for the caller to check on the output
+    char buffer[65536];
+    for (size_t count; (count = fread(buffer, 1, sizeof(buffer), entry)) > 0;) {
+        if (fwrite(buffer, 1, count, output) != count)
+            break;
+    }
+
+    fclose(entry);
+    return true;
+}
+
+bool conversion_cache_store(const char *cache_dir, uint64_t key, OutputFormat format,
+                            const std::function<bool(FILE *)> &produce)
+{
+    if (mkdir(cache_dir, 0777) != 0 && errno != EEXIST)
+        return false;
+
+    std::string path = cache_entry_path(cache_dir, key, format);
+
+    // write a temporary file next to the entry, so it can be renamed
+    std::string temp_path = path + ".XXXXXX";
+    int fd = mkstemp(&temp_path[0]);
+    if (fd == -1)
+        return false;
+
+    FILE *temp = fdopen(fd, "wb");
+    if (!temp) {
+        close(fd);
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    bool ok = produce(temp);
+    ok = fflush(temp) == 0 && ok;
+    ok = !ferror(temp) && ok;
+    ok = fsync(fileno(temp)) == 0 && ok;
+    ok = fclose(temp) == 0 && ok;
+
+    // the permissions of mkstemp are restricted to the owner
+    ok = ok && chmod(temp_path.c_str(), 0644) == 0;
+
+    // the rename is atomic: concurrent jobs see either no entry or a
+    // complete one, and a job which loses the race replaces the entry by
+    // identical contents
+    ok = ok && rename(temp_path.c_str(), path.c_str()) == 0;
+
+    if (!ok)
+        unlink(temp_path.c_str());
+    return ok;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "conversion.h"
+#include <functional>
+
+// compute the key of a conversion, from the input data and all the
+// parameters which affect the output
+uint64_t conversion_cache_key(const Waveform &wave, const ConversionOptions &options);
+
+// if the cache has an entry for the key, copy it to the output and return
+// true; write errors are indicated by the error flag of the output
+bool conversion_cache_fetch(const char *cache_dir, uint64_t key, OutputFormat format, FILE *output);
+
+// create an entry for the key, with the contents written by the function,
+// and publish it atomically when complete
+bool conversion_cache_store(const char *cache_dir, uint64_t key, OutputFormat format,
+                            const std::function<bool(FILE *)> &produce);
@@ -0,0 +1,226 @@
+#include "conversion_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+
+//------------------------------------------------------------------------------
+// count the allocated bytes, by replacing the global operators
+
+static std::atomic<uint64_t> allocated_bytes { 0 };
+
+static void *counted_alloc(std::size_t size) noexcept
+{
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new(std::size_t size)
+{
+    void *ptr = counted_alloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    std::free(ptr);
+}
+
+uint64_t stats_allocated_bytes()
+{
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+uint64_t stats_peak_rss_bytes()
+{
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+//------------------------------------------------------------------------------
+bool parse_stats_format(const char *text, StatsFormat &format)
+{
+    if (!strcmp(text, "text"))
+        format = StatsFormat::Text;
+    else if (!strcmp(text, "json"))
+        format = StatsFormat::Json;
+    else
+        return false;
+    return true;
+}
+
+static void print_json_string(FILE *stream, const char *text)
+{
+    fputc('"', stream);
+    for (const char *p = text; *p; ++p) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\')
+            fprintf(stream, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(stream, "\\u%04x", c);
+        else
+            fputc(c, stream);
+    }
+    fputc('"', stream);
+}
+
+static double mebibytes(uint64_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+void print_conversion_stats(FILE *stream, StatsFormat format, const char *input_path, const ConversionStats &stats)
+{
+    if (format == StatsFormat::Json) {
+        fputs("{\"input\":", stream);
+        print_json_string(stream, input_path);
+        fprintf(stream,
+                ",\"cached\":%s,\"decode_ms\":%.3f,\"analysis_ms\":%.3f,\"synthesis_ms\":%.3f"
+                ",\"fill_extra_ms\":%.3f,\"write_ms\":%.3f,\"total_ms\":%.3f"
+                ",\"analysis_cpu_ms\":%.3f,\"synthesis_cpu_ms\":%.3f,\"fill_extra_cpu_ms\":%.3f"
+                ",\"allocated_bytes\":%llu,\"peak_rss_bytes\":%llu,\"output_bytes\":",
+                stats.cached ? "true" : "false", stats.decode_ms, stats.analysis_ms, stats.synthesis_ms,
+                stats.fill_extra_ms, stats.write_ms, stats.total_ms,
+                stats.analysis_cpu_ms, stats.synthesis_cpu_ms, stats.fill_extra_cpu_ms,
+                (unsigned long long)stats.allocated_bytes, (unsigned long long)stats.peak_rss_bytes);
+        if (stats.output_bytes < 0)
+            fputs("null}\n", stream);
+        else
+            fprintf(stream, "%lld}\n", (long long)stats.output_bytes);
+        return;
+    }
+
+    fprintf(stream,
+            "%s:%s decode %.3f ms, analysis %.3f ms (CPU %.3f ms), synthesis %.3f ms (CPU %.3f ms),"
+            " fill-extra %.3f ms (CPU %.3f ms), write %.3f ms, total %.3f ms;"
+            " allocated %.2f MiB, peak RSS %.2f MiB",
+            input_path, stats.cached ? " (cached)" : "", stats.decode_ms,
+            stats.analysis_ms, stats.analysis_cpu_ms, stats.synthesis_ms, stats.synthesis_cpu_ms,
+            stats.fill_extra_ms, stats.fill_extra_cpu_ms, stats.write_ms, stats.total_ms,
+            mebibytes(stats.allocated_bytes), mebibytes(stats.peak_rss_bytes));
+    if (stats.output_bytes < 0)
+        fputs(", output unknown\n", stream);
+    else
+        fprintf(stream, ", output %lld bytes\n", (long long)stats.output_bytes);
+}
+
+//------------------------------------------------------------------------------
+struct Percentiles {
+    double p50 = 0;
+    double p90 = 0;
+    double max = 0;
+};
+
+// the percentiles by the nearest rank
+static Percentiles compute_percentiles(std::vector<double> values)
+{
+    Percentiles pc;
+    if (values.empty())
+        return pc;
+
+    std::sort(values.begin(), values.end());
+    auto rank = [&values](double p) -> double {
+        size_t n = values.size();
+        size_t r = (size_t)std::ceil(p * n);
+        return values[std::min(n, std::max<size_t>(r, 1)) - 1];
+    };
+    pc.p50 = rank(0.5);
+    pc.p90 = rank(0.9);
+    pc.max = values.back();
+    return pc;
+}
+
+void print_conversion_stats_summary(FILE *stream, StatsFormat format, const std::vector<ConversionStats> &stats)
+{
+    struct Measure {
+        const char *name;
+        const char *label;
+        double scale;
+        std::vector<double> values;
+    };
+
+    Measure measures[] = {
+        {"decode_ms", "decode (ms)", 1, {}},
+        {"analysis_ms", "analysis (ms)", 1, {}},
+        {"synthesis_ms", "synthesis (ms)", 1, {}},
+        {"fill_extra_ms", "fill-extra (ms)", 1, {}},
+        {"write_ms", "write (ms)", 1, {}},
+        {"total_ms", "total (ms)", 1, {}},
+        {"allocated_bytes", "allocated (MiB)", 1.0 / (1024 * 1024), {}},
+        {"output_bytes", "output (KiB)", 1.0 / 1024, {}},
+    };
+
+    for (const ConversionStats &s : stats) {
+        measures[0].values.push_back(s.decode_ms);
+        measures[1].values.push_back(s.analysis_ms);
+        measures[2].values.push_back(s.synthesis_ms);
+        measures[3].values.push_back(s.fill_extra_ms);
+        measures[4].values.push_back(s.write_ms);
+        measures[5].values.push_back(s.total_ms);
+        measures[6].values.push_back((double)s.allocated_bytes);
+        if (s.output_bytes >= 0)
+            measures[7].values.push_back((double)s.output_bytes);
+    }
+
+    uint64_t peak_rss = stats_peak_rss_bytes();
+
+    if (format == StatsFormat::Json) {
+        fprintf(stream, "{\"summary\":{\"count\":%zu", stats.size());
+        for (const Measure &m : measures) {
+            Percentiles pc = compute_percentiles(m.values);
+            fprintf(stream, ",\"%s\":{\"p50\":%.3f,\"p90\":%.3f,\"max\":%.3f}", m.name, pc.p50, pc.p90, pc.max);
+        }
+        fprintf(stream, ",\"peak_rss_bytes\":%llu}}\n", (unsigned long long)peak_rss);
+        return;
+    }
+
+    fprintf(stream, "Summary of %zu conversions:\n", stats.size());
+    fprintf(stream, "  %-20s %12s %12s %12s\n", "", "p50", "p90", "max");
+    for (const Measure &m : measures) {
+        Percentiles pc = compute_percentiles(m.values);
+        fprintf(stream, "  %-20s %12.3f %12.3f %12.3f\n", m.label,
+                pc.p50 * m.scale, pc.p90 * m.scale, pc.max * m.scale);
+    }
+    fprintf(stream, "  peak RSS: %.2f MiB\n", mebibytes(peak_rss));
+}
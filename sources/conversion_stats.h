@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+enum class StatsFormat {
+    Text,
+    Json,
+};
+
+// the measures of a conversion; the time of a stage is the wall time during
+// which at least one thread runs it, and the CPU time of the stages which
+// run on several threads is the sum of the times of the threads
+struct ConversionStats {
+    double decode_ms = 0;
+    double analysis_ms = 0;
+    double synthesis_ms = 0;
+    double fill_extra_ms = 0;
+    double analysis_cpu_ms = 0;
+    double synthesis_cpu_ms = 0;
+    double fill_extra_cpu_ms = 0;
+    double write_ms = 0;
+    double total_ms = 0;
+    // bytes allocated by the conversion, even if freed since
+    uint64_t allocated_bytes = 0;
+    // peak of the resident memory of the process at the end of the conversion
+    uint64_t peak_rss_bytes = 0;
+    // bytes written to the output, or negative if unknown
+    int64_t output_bytes = -1;
+    // whether the output is a copy of a cache entry
+    bool cached = false;
+};
+
+// a clock which starts at construction
+class StatsTimer {
+public:
+    double elapsed_ms() const
+    {
+        std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now() - start_;
+        return d.count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+// the number of bytes which the process allocated since it started
+uint64_t stats_allocated_bytes();
+
+// the peak of the resident memory of the process since it started
+uint64_t stats_peak_rss_bytes();
+
+bool parse_stats_format(const char *text, StatsFormat &format);
+
+// print the measures of the conversion of an input, on a line
+void print_conversion_stats(FILE *stream, StatsFormat format, const char *input_path, const ConversionStats &stats);
+
+// print the percentiles of the measures of several conversions
+void print_conversion_stats_summary(FILE *stream, StatsFormat format, const std::vector<ConversionStats> &stats);
@@ -0,0 +1,555 @@
+#include "daemon_mode.h"
+#include "daemon_protocol.h"
+#include "conversion_cache.h"
+#include "sfizz/Wavetables.h"
+#include <nonstd/scope.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// the size above which the client passes the payloads in shared memory
+static constexpr uint64_t daemon_client_shm_threshold = 1 << 20;
+
+// the largest input accepted by the daemon, 64 MiB of samples
+static constexpr uint64_t daemon_max_frame_count = 1ull << 24;
+
+// the largest table size accepted by the daemon, for an output of 6 MiB
+static constexpr uint32_t daemon_max_table_size = 1u << 16;
+
+// the capacity above which a worker releases its buffers after a request,
+// so that a large request does not hold memory for the whole connection
+static constexpr size_t daemon_kept_buffer_size = 1u << 22;
+
+// the time after which a worker drops a client which neither sends nor
+// receives, so that idle connections do not hold the workers
+static constexpr int daemon_client_timeout = 10;
+
+static bool read_full(int fd, void *data, size_t size)
+{
+    char *p = (char *)data;
+    while (size > 0) {
+        ssize_t count = read(fd, p, size);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        p += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+    while (size > 0) {
+        ssize_t count = send(fd, p, size, MSG_NOSIGNAL);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        p += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+// read at an offset of a file, failing on a short read
+static bool pread_full(int fd, void *data, size_t size, off_t offset)
+{
+    char *p = (char *)data;
+    while (size > 0) {
+        ssize_t count = pread(fd, p, size, offset);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        p += count;
+        size -= (size_t)count;
+        offset += count;
+    }
+    return true;
+}
+
+static bool pwrite_full(int fd, const void *data, size_t size, off_t offset)
+{
+    const char *p = (const char *)data;
+    while (size > 0) {
+        ssize_t count = pwrite(fd, p, size, offset);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        p += count;
+        size -= (size_t)count;
+        offset += count;
+    }
+    return true;
+}
+
+static uint64_t binary_mipmap_size(uint32_t table_size)
+{
+    return sizeof(BinaryMipmapHeader) + (uint64_t)sfz::MipmapRange::N * table_size * sizeof(float);
+}
+
+static bool is_valid_request(const DaemonRequest &req)
+{
+    return memcmp(req.magic, "WTRQ", 4) == 0 &&
+        req.version == daemon_protocol_version &&
+        req.tableSize >= 4 && req.tableSize <= daemon_max_table_size && (req.tableSize & 1) == 0 &&
+        req.cycles >= 1 && req.frameCount >= std::max<uint64_t>(4, 2 * (uint64_t)req.cycles) &&
+        req.frameCount <= daemon_max_frame_count &&
+        req.amplitude > 0 && req.refSampleRate > 0 &&
+        memchr(req.shmName, '\0', sizeof(req.shmName)) != nullptr;
+}
+
+// write the binary mipmap of a waveform to memory of `binary_mipmap_size`
+static void generate_binary_mipmap(nonstd::span<const float> wave, const DaemonRequest &req, char *dest)
+{
+    const BinaryMipmapHeader header = make_binary_mipmap_header(req.tableSize);
+    memcpy(dest, &header, sizeof(header));
+
+    char *tables = dest + sizeof(header);
+    const size_t table_bytes = (size_t)req.tableSize * sizeof(float);
+
+    sfz::WavetableMulti::generateFromAudioData(
+        wave,
+        [tables, table_bytes](unsigned table_no, nonstd::span<const float> table) {
+            memcpy(tables + table_no * table_bytes, table.data(), table_bytes);
+        },
+        req.amplitude, req.tableSize, req.refSampleRate, req.cycles);
+}
+
+// whether a shared memory name is one which the client creates
+static bool is_client_shm_name(const char *name)
+{
+    const size_t prefix_length = strlen(daemon_shm_name_prefix);
+    return strncmp(name, daemon_shm_name_prefix, prefix_length) == 0 &&
+        name[prefix_length] != '\0' && strchr(name + prefix_length, '/') == nullptr;
+}
+
+// process a request whose payloads are in shared memory, which must belong
+// to the user of the client. the client may resize the object at any time,
+// and an access to a mapping past its end would fault, so the daemon reads
+// and writes it by copies, which fail instead.
+static uint32_t serve_shm_request(const DaemonRequest &req, uint64_t output_size, uid_t client_uid,
+                                  std::vector<float> &samples, std::vector<char> &output)
+{
+    if (!is_client_shm_name(req.shmName))
+        return daemon_status_bad_shm;
+
+    int shm_fd = shm_open(req.shmName, O_RDWR | O_NOFOLLOW, 0);
+    if (shm_fd == -1)
+        return daemon_status_bad_shm;
+    auto shm_fd_cleanup = nonstd::make_scope_exit([shm_fd]() { close(shm_fd); });
+
+    struct stat st;
+    if (fstat(shm_fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != client_uid ||
+        (uint64_t)st.st_size < req.shmSize)
+        return daemon_status_bad_shm;
+
+    const uint64_t output_offset = daemon_shm_output_offset(req.frameCount);
+    if (req.shmSize < output_offset + output_size)
+        return daemon_status_shm_too_small;
+
+    samples.resize((size_t)req.frameCount);
+    if (!pread_full(shm_fd, samples.data(), samples.size() * sizeof(float), 0))
+        return daemon_status_bad_shm;
+
+    output.resize((size_t)output_size);
+    generate_binary_mipmap(samples, req, output.data());
+
+    if (!pwrite_full(shm_fd, output.data(), output.size(), (off_t)output_offset))
+        return daemon_status_bad_shm;
+
+    return daemon_status_ok;
+}
+
+// process the requests of a client until it disconnects
+static void serve_client(int fd)
+{
+    // the user of the client, who must own its shared memory
+    ucred cred;
+    socklen_t cred_size = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_size) != 0) {
+        close(fd);
+        return;
+    }
+
+    // reused from one request to the next, unless large
+    std::vector<float> samples;
+    std::vector<char> output;
+
+    for (;;) {
+        DaemonRequest req;
+        if (!read_full(fd, &req, sizeof(req)))
+            break;
+
+        DaemonResponse res;
+        memcpy(res.magic, "WTRS", 4);
+        res.status = daemon_status_ok;
+        res.size = 0;
+
+        if (!is_valid_request(req)) {
+            // the rest of the stream cannot be interpreted
+            res.status = daemon_status_bad_request;
+            write_full(fd, &res, sizeof(res));
+            break;
+        }
+
+        const uint64_t output_size = binary_mipmap_size(req.tableSize);
+        const bool shm = (req.flags & daemon_request_shm) != 0;
+
+        try {
+            if (!shm)
+                samples.resize((size_t)req.frameCount);
+        }
+        catch (std::exception &) {
+            // the samples which follow cannot be skipped without reading
+            res.status = daemon_status_failure;
+            write_full(fd, &res, sizeof(res));
+            break;
+        }
+
+        if (!shm && !read_full(fd, samples.data(), samples.size() * sizeof(float)))
+            break;
+
+        try {
+            if (shm)
+                res.status = serve_shm_request(req, output_size, cred.uid, samples, output);
+            else {
+                output.resize((size_t)output_size);
+                generate_binary_mipmap(samples, req, output.data());
+            }
+        }
+        catch (std::exception &) {
+            res.status = daemon_status_failure;
+        }
+
+        if (res.status == daemon_status_ok || res.status == daemon_status_shm_too_small)
+            res.size = output_size;
+
+        if (!write_full(fd, &res, sizeof(res)))
+            break;
+        if (!shm && res.status == daemon_status_ok && !write_full(fd, output.data(), output.size()))
+            break;
+
+        if (samples.capacity() * sizeof(float) > daemon_kept_buffer_size)
+            std::vector<float>().swap(samples);
+        if (output.capacity() > daemon_kept_buffer_size)
+            std::vector<char>().swap(output);
+    }
+
+    close(fd);
+}
+
+//------------------------------------------------------------------------------
+namespace {
+
+// the connections waiting for a worker thread
+class ConnectionQueue {
+public:
+    void push(int fd)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fds_.push_back(fd);
+        cond_.notify_one();
+    }
+
+    // get the next connection, or -1 when closed
+    int pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return closed_ || !fds_.empty(); });
+        if (fds_.empty())
+            return -1;
+        int fd = fds_.front();
+        fds_.pop_front();
+        return fd;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        cond_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<int> fds_;
+    bool closed_ = false;
+};
+
+} // namespace
+
+static bool make_socket_address(const char *socket_path, sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+        return false;
+    strcpy(addr.sun_path, socket_path);
+    return true;
+}
+
+int run_daemon_mode(const char *socket_path, unsigned num_threads)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    sockaddr_un addr;
+    if (!make_socket_address(socket_path, addr)) {
+        fprintf(stderr, "The socket path is too long.\n");
+        return 1;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        fprintf(stderr, "Cannot create the socket.\n");
+        return 1;
+    }
+    auto listen_fd_cleanup = nonstd::make_scope_exit([listen_fd]() { close(listen_fd); });
+
+    // remove the socket left by a previous daemon
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    if (bind(listen_fd, (const sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Cannot listen on the socket.\n");
+        return 1;
+    }
+    auto socket_cleanup = nonstd::make_scope_exit([socket_path]() { unlink(socket_path); });
+
+    ConnectionQueue queue;
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < num_threads; ++i) {
+        workers.emplace_back([&queue]() {
+            for (int fd; (fd = queue.pop()) != -1;)
+                serve_client(fd);
+        });
+    }
+
+    fprintf(stderr, "Listening on %s with %u threads.\n", socket_path, num_threads);
+
+    for (;;) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fprintf(stderr, "Cannot accept connections.\n");
+            break;
+        }
+
+        timeval timeout;
+        timeout.tv_sec = daemon_client_timeout;
+        timeout.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        queue.push(fd);
+    }
+
+    queue.close();
+    for (std::thread &worker : workers)
+        worker.join();
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// write a binary mipmap received from the daemon in the given format
+static bool write_received_mipmap(const char *mipmap, OutputFormat format, FILE *output)
+{
+    BinaryMipmapHeader header;
+    memcpy(&header, mipmap, sizeof(header));
+
+    std::unique_ptr<MipmapWriter> writer = create_mipmap_writer(format, output);
+    if (!writer->begin(header.tableSize))
+        return false;
+
+    std::vector<float> table(header.tableSize);
+    const char *tables = mipmap + sizeof(header);
+    for (uint32_t table_no = 0; table_no < header.numTables; ++table_no) {
+        memcpy(table.data(), tables + table_no * table.size() * sizeof(float), table.size() * sizeof(float));
+        writer->write_table(table_no, table);
+    }
+    writer->end();
+    return true;
+}
+
+int run_daemon_client(const char *socket_path, const ConversionJob &job, const ConversionOptions &job_options)
+{
+    Waveform raw;
+    int ret = read_file_waveform(job.input_path.c_str(), raw);
+    if (ret != 0)
+        return ret;
+    if (raw.channels != 1) {
+        fprintf(stderr, "The daemon converts sound files of a single channel.\n");
+        return 1;
+    }
+
+    // the client chooses the size, which is a parameter of the request
+    ConversionOptions options = job_options;
+    apply_auto_size(raw, job.input_path.c_str(), options);
+
+    FILE *output = stdout;
+    auto output_cleanup = nonstd::make_scope_exit([&output]() {
+        if (output != stdout)
+            fclose(output);
+    });
+    auto open_output = [&output, &job]() -> bool {
+        if (output != stdout || job.output_path.empty())
+            return true;
+        output = fopen(job.output_path.c_str(), "wb");
+        if (!output) {
+            output = stdout;
+            fprintf(stderr, "Cannot open output file.\n");
+            return false;
+        }
+        return true;
+    };
+
+    // the cache is shared with the conversions which run in the process,
+    // and an entry spares the request
+    const bool cached = !options.cache_dir.empty();
+    const uint64_t cache_key = cached ? conversion_cache_key(raw, options) : 0;
+    if (cached) {
+        if (!open_output())
+            return 1;
+        if (conversion_cache_fetch(options.cache_dir.c_str(), cache_key, options.format, output)) {
+            fflush(output);
+            if (ferror(output)) {
+                fprintf(stderr, "Cannot write output file.\n");
+                return 1;
+            }
+            return 0;
+        }
+    }
+
+    sockaddr_un addr;
+    if (!make_socket_address(socket_path, addr)) {
+        fprintf(stderr, "The socket path is too long.\n");
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1 || connect(fd, (const sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (fd != -1)
+            close(fd);
+        fprintf(stderr, "Cannot connect to the daemon.\n");
+        return 1;
+    }
+    auto fd_cleanup = nonstd::make_scope_exit([fd]() { close(fd); });
+
+    DaemonRequest req;
+    memset(&req, 0, sizeof(req));
+    memcpy(req.magic, "WTRQ", 4);
+    req.version = daemon_protocol_version;
+    req.tableSize = options.table_size;
+    req.cycles = options.cycles;
+    req.amplitude = options.amplitude;
+    req.refSampleRate = options.ref_sample_rate;
+    req.frameCount = raw.size;
+
+    const uint64_t input_size = (uint64_t)raw.size * sizeof(float);
+    const uint64_t output_size = binary_mipmap_size(options.table_size);
+    const bool shm = input_size >= daemon_client_shm_threshold;
+
+    void *map = MAP_FAILED;
+    auto shm_cleanup = nonstd::make_scope_exit([&map, &req]() {
+        if (map != MAP_FAILED) {
+            munmap(map, (size_t)req.shmSize);
+            shm_unlink(req.shmName);
+        }
+    });
+
+    if (shm) {
+        static unsigned counter = 0;
+        snprintf(req.shmName, sizeof(req.shmName), "%s%d-%u", daemon_shm_name_prefix, (int)getpid(), counter++);
+        req.flags |= daemon_request_shm;
+        req.shmSize = daemon_shm_output_offset(req.frameCount) + output_size;
+
+        int shm_fd = shm_open(req.shmName, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (shm_fd == -1) {
+            fprintf(stderr, "Cannot create the shared memory.\n");
+            return 1;
+        }
+        if (ftruncate(shm_fd, (off_t)req.shmSize) == 0)
+            map = mmap(nullptr, (size_t)req.shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        close(shm_fd);
+        if (map == MAP_FAILED) {
+            shm_unlink(req.shmName);
+            fprintf(stderr, "Cannot create the shared memory.\n");
+            return 1;
+        }
+        memcpy(map, raw.data.get(), (size_t)input_size);
+    }
+
+    DaemonResponse res;
+    bool sent = write_full(fd, &req, sizeof(req)) &&
+        (shm || write_full(fd, raw.data.get(), (size_t)input_size));
+    if (!sent || !read_full(fd, &res, sizeof(res)) || memcmp(res.magic, "WTRS", 4) != 0) {
+        fprintf(stderr, "Cannot communicate with the daemon.\n");
+        return 1;
+    }
+    if (res.status != daemon_status_ok || res.size != output_size) {
+        fprintf(stderr, "The daemon failed to convert, with status %u.\n", res.status);
+        return 1;
+    }
+
+    std::vector<char> received;
+    const char *mipmap;
+    if (shm)
+        mipmap = (const char *)map + daemon_shm_output_offset(req.frameCount);
+    else {
+        received.resize((size_t)res.size);
+        if (!read_full(fd, received.data(), received.size())) {
+            fprintf(stderr, "Cannot communicate with the daemon.\n");
+            return 1;
+        }
+        mipmap = received.data();
+    }
+
+    // write the received tables in the requested format
+    if (!open_output())
+        return 1;
+
+    bool written;
+    if (cached) {
+        const char *cache_dir = options.cache_dir.c_str();
+        bool stored = conversion_cache_store(cache_dir, cache_key, options.format, [mipmap, &options](FILE *stream) {
+            return write_received_mipmap(mipmap, options.format, stream);
+        });
+        if (stored)
+            written = conversion_cache_fetch(cache_dir, cache_key, options.format, output);
+        else {
+            fprintf(stderr, "Cannot write the cache entry.\n");
+            written = write_received_mipmap(mipmap, options.format, output);
+        }
+    }
+    else
+        written = write_received_mipmap(mipmap, options.format, output);
+
+    fflush(output);
+    if (!written || ferror(output)) {
+        fprintf(stderr, "Cannot write output file.\n");
+        return 1;
+    }
+
+    return 0;
+}
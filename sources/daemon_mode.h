@@ -0,0 +1,8 @@
+#pragma once
+#include "conversion.h"
+
+// serve conversion requests on a UNIX socket, with a pool of threads
+int run_daemon_mode(const char *socket_path, unsigned num_threads);
+
+// run a conversion job by a request to the daemon
+int run_daemon_client(const char *socket_path, const ConversionJob &job, const ConversionOptions &options);
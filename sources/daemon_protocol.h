@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+
+// Protocol of the conversion daemon, over a UNIX stream socket.
+//
+// A client sends any number of requests on a connection, each answered by a
+// response. All fields are in the byte order of the host.
+//
+// Without shared memory, the request header is followed by `frameCount`
+// samples in 32-bit float, and the response header by `size` bytes of the
+// binary mipmap (see BinaryMipmapHeader).
+//
+// With shared memory, the client creates a POSIX shared memory object of
+// `shmSize` bytes, which starts with the samples. Its name starts with
+// `daemon_shm_name_prefix`, and it belongs to the user of the client. The
+// daemon writes the binary mipmap at the offset
+// `daemon_shm_output_offset(frameCount)`, and replies with the header only.
+// If the object is too small, the status is `daemon_status_shm_too_small`,
+// and `size` is the size of the mipmap.
+//
+// The table size is at most 65536. The daemon closes a connection which
+// stays idle for 10 seconds.
+
+struct DaemonRequest {
+    char magic[4]; // "WTRQ"
+    uint32_t version;
+    uint32_t tableSize;
+    uint32_t cycles;
+    double amplitude;
+    double refSampleRate;
+    uint64_t frameCount;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t shmSize;
+    char shmName[64];
+};
+
+struct DaemonResponse {
+    char magic[4]; // "WTRS"
+    uint32_t status;
+    uint64_t size;
+};
+
+enum : uint32_t {
+    daemon_protocol_version = 1,
+};
+
+enum : uint32_t {
+    // the payloads are in the shared memory object
+    daemon_request_shm = 1u << 0,
+};
+
+enum : uint32_t {
+    daemon_status_ok = 0,
+    daemon_status_bad_request = 1,
+    daemon_status_bad_shm = 2,
+    daemon_status_shm_too_small = 3,
+    daemon_status_failure = 4,
+};
+
+// the prefix of the names of the shared memory objects of the clients
+static constexpr const char *daemon_shm_name_prefix = "/make-wavetable-";
+
+// the offset of the output in the shared memory, after the input samples
+inline uint64_t daemon_shm_output_offset(uint64_t frame_count)
+{
+    return (frame_count * sizeof(float) + 63) & ~(uint64_t)63;
+}
@@ -1,146 +1,394 @@
-#include "sfizz/Wavetables.h"
-#include "dr_wav_library.h"
+#include "conversion.h"
+#include "watch_mode.h"
+#include "daemon_mode.h"
+#include "render_mode.h"
 #include <getopt.h>
-#include <nonstd/scope.hpp>
-#include <memory>
+#include <string>
+#include <vector>
 #include <cstdio>
+#include <cstdlib>
+#include <cstdint>
 
-struct Waveform {
-    std::unique_ptr<float[]> data;
-    uint32_t size = 0;
-    explicit operator bool() const noexcept { return data != nullptr; }
+static void show_usage();
+static bool parse_table_size(const char *text, uint32_t &size);
+static bool parse_cycles(const char *text, uint32_t &cycles);
+static bool parse_milliseconds(const char *text, unsigned &ms);
+static bool parse_threads(const char *text, unsigned &threads);
+static bool parse_sample_rate(const char *text, double &rate);
+static bool parse_threshold(const char *text, double &threshold);
+static bool parse_frames(const char *text, uint32_t &frames);
+
+enum {
+    opt_debounce = 256,
+    opt_daemon,
+    opt_connect,
+    opt_threads,
+    opt_stats,
+    opt_render,
+    opt_sample_rate,
+    opt_auto_size,
+    opt_morph,
 };
 
-static void show_usage();
-static int read_file_waveform(const char *path, Waveform &wave);
-static void write_mipmap(FILE *stream, sfz::WavetableMulti &mipmap);
+static const option long_options[] = {
+    {"help", no_argument, nullptr, 'h'},
+    {"input", required_argument, nullptr, 'i'},
+    {"output", required_argument, nullptr, 'o'},
+    {"format", required_argument, nullptr, 'f'},
+    {"table-size", required_argument, nullptr, 's'},
+    {"cycles", required_argument, nullptr, 'c'},
+    {"cache", required_argument, nullptr, 'C'},
+    {"watch", no_argument, nullptr, 'w'},
+    {"bank", no_argument, nullptr, 'b'},
+    {"debounce", required_argument, nullptr, opt_debounce},
+    {"daemon", required_argument, nullptr, opt_daemon},
+    {"connect", required_argument, nullptr, opt_connect},
+    {"threads", required_argument, nullptr, opt_threads},
+    {"stats", optional_argument, nullptr, opt_stats},
+    {"render", required_argument, nullptr, opt_render},
+    {"sample-rate", required_argument, nullptr, opt_sample_rate},
+    {"auto-size", optional_argument, nullptr, opt_auto_size},
+    {"morph", required_argument, nullptr, opt_morph},
+    {nullptr, 0, nullptr, 0},
+};
 
 int main(int argc, char *argv[])
 {
-    const char *input_path = nullptr;
+    std::vector<std::string> input_paths;
     const char *output_path = nullptr;
+    ConversionOptions options;
+    bool watch = false;
+    bool bank = false;
+    unsigned debounce_ms = 50;
+    const char *daemon_socket = nullptr;
+    const char *connect_socket = nullptr;
+    unsigned num_threads = 0;
+    bool stats = false;
+    StatsFormat stats_format = StatsFormat::Text;
+    const char *render_events = nullptr;
+    RenderOptions render_options;
+    uint32_t morph_frames = 0;
+
+    if (const char *cache_dir = getenv("MAKE_WAVETABLE_CACHE"))
+        options.cache_dir = cache_dir;
 
     if (argc <= 1) {
         show_usage();
         return 0;
     }
 
-    for (int c; (c = getopt(argc, argv, "hi:o:")) != -1;) {
+    for (int c; (c = getopt_long(argc, argv, "hi:o:f:s:c:C:wb", long_options, nullptr)) != -1;) {
         switch (c) {
         case 'h':
             show_usage();
             return 0;
         case 'i':
-            input_path = optarg;
+            input_paths.push_back(optarg);
             break;
         case 'o':
             output_path = optarg;
             break;
+        case 'f':
+            if (!parse_output_format(optarg, options.format)) {
+                fprintf(stderr, "Invalid output format.\n");
+                return 1;
+            }
+            break;
+        case 's':
+            if (!parse_table_size(optarg, options.table_size)) {
+                fprintf(stderr, "Invalid table size.\n");
+                return 1;
+            }
+            break;
+        case 'c':
+            if (!parse_cycles(optarg, options.cycles)) {
+                fprintf(stderr, "Invalid number of cycles.\n");
+                return 1;
+            }
+            break;
+        case 'C':
+            options.cache_dir = optarg;
+            break;
+        case 'w':
+            watch = true;
+            break;
+        case 'b':
+            bank = true;
+            break;
+        case opt_debounce:
+            if (!parse_milliseconds(optarg, debounce_ms)) {
+                fprintf(stderr, "Invalid debounce time.\n");
+                return 1;
+            }
+            break;
+        case opt_daemon:
+            daemon_socket = optarg;
+            break;
+        case opt_connect:
+            connect_socket = optarg;
+            break;
+        case opt_threads:
+            if (!parse_threads(optarg, num_threads)) {
+                fprintf(stderr, "Invalid number of threads.\n");
+                return 1;
+            }
+            break;
+        case opt_stats:
+            stats = true;
+            if (optarg && !parse_stats_format(optarg, stats_format)) {
+                fprintf(stderr, "Invalid format of statistics.\n");
+                return 1;
+            }
+            break;
+        case opt_render:
+            render_events = optarg;
+            break;
+        case opt_sample_rate:
+            if (!parse_sample_rate(optarg, render_options.sample_rate)) {
+                fprintf(stderr, "Invalid sample rate.\n");
+                return 1;
+            }
+            break;
+        case opt_auto_size:
+            options.auto_size = true;
+            if (optarg && !parse_threshold(optarg, options.auto_size_threshold_db)) {
+                fprintf(stderr, "Invalid threshold of the automatic size.\n");
+                return 1;
+            }
+            break;
+        case opt_morph:
+            if (!parse_frames(optarg, morph_frames)) {
+                fprintf(stderr, "Invalid number of frames.\n");
+                return 1;
+            }
+            break;
         default:
             return 1;
         }
     }
 
-    if (argc != optind || !input_path) {
+    if (daemon_socket) {
+        if (argc != optind || !input_paths.empty()) {
+            fprintf(stderr, "The daemon mode does not take inputs.\n");
+            return 1;
+        }
+        return run_daemon_mode(daemon_socket, num_threads);
+    }
+
+    if (argc != optind || input_paths.empty()) {
         fprintf(stderr, "Invalid arguments\n");
         show_usage();
         return 1;
     }
-
-    Waveform raw;
-    int ret = read_file_waveform(input_path, raw);
-    if (ret != 0)
+    if (watch && connect_socket) {
+        fprintf(stderr, "The watch mode cannot connect to a daemon.\n");
+        return 1;
+    }
+    if (render_events) {
+        if (watch || bank || morph_frames || connect_socket || stats) {
+            fprintf(stderr, "The render mode cannot be combined with other modes.\n");
+            return 1;
+        }
+        if (input_paths.size() != 1 || is_directory(input_paths[0]) || !output_path) {
+            fprintf(stderr, "The render mode requires a single sound file and an output.\n");
+            return 1;
+        }
+        render_options.num_threads = num_threads;
+        return run_render_mode(input_paths[0].c_str(), render_events, output_path, options, render_options);
+    }
+    if (stats && connect_socket) {
+        fprintf(stderr, "The statistics are not available from a daemon.\n");
+        return 1;
+    }
+    if (morph_frames) {
+        if (watch || bank || connect_socket) {
+            fprintf(stderr, "The morph cannot be combined with other modes.\n");
+            return 1;
+        }
+        if (input_paths.size() != 2 || is_directory(input_paths[0]) || is_directory(input_paths[1])) {
+            fprintf(stderr, "The morph requires two sound files.\n");
+            return 1;
+        }
+        ConversionStats morph_stats;
+        int ret = run_morph_conversion(input_paths, output_path, morph_frames, options, stats ? &morph_stats : nullptr);
+        if (stats && ret == 0)
+            print_conversion_stats(stderr, stats_format, output_path ? output_path : "-", morph_stats);
         return ret;
-
-    sfz::WavetableMulti mipmap = sfz::WavetableMulti::createFromAudioData(
-        nonstd::span<const float>(raw.data.get(), raw.size), 1.0);
-
-    ///
-    FILE *output = stdout;
-    if (output_path) {
-        output = fopen(output_path, "wb");
-        if (!output) {
-            fprintf(stderr, "Cannot open output file.\n");
+    }
+    if (bank) {
+        if (watch || connect_socket) {
+            fprintf(stderr, "The bank mode cannot watch or connect to a daemon.\n");
             return 1;
         }
+        ConversionStats bank_stats;
+        int ret = run_bank_conversion(input_paths, output_path, options, stats ? &bank_stats : nullptr);
+        if (stats && ret == 0)
+            print_conversion_stats(stderr, stats_format, output_path ? output_path : "-", bank_stats);
+        return ret;
+    }
+    if (watch && !output_path) {
+        fprintf(stderr, "The watch mode requires an output.\n");
+        return 1;
     }
 
-    write_mipmap(output, mipmap);
+    std::vector<ConversionJob> jobs;
+    if (!collect_conversion_jobs(input_paths, output_path, options.format, jobs))
+        return 1;
 
-    if (output_path) {
-        fflush(output);
-        int err = ferror(output);
-        fclose(output);
-        if (err) {
-            fprintf(stderr, "Cannot write output file.\n");
-            return 1;
+    const bool batch = is_batch_conversion(input_paths);
+
+    int ret = 0;
+    std::vector<ConversionStats> job_stats;
+    for (const ConversionJob &job : jobs) {
+        ConversionStats current_stats;
+        int job_ret = connect_socket ? run_daemon_client(connect_socket, job, options)
+                                     : run_conversion_job(job, options, stats ? &current_stats : nullptr);
+        if (job_ret != 0) {
+            if (batch)
+                fprintf(stderr, "Cannot convert: %s\n", job.input_path.c_str());
+            ret = job_ret;
+        }
+        else if (stats) {
+            print_conversion_stats(stderr, stats_format, job.input_path.c_str(), current_stats);
+            job_stats.push_back(current_stats);
         }
     }
+    if (stats && batch && !job_stats.empty())
+        print_conversion_stats_summary(stderr, stats_format, job_stats);
+
+    if (watch)
+        ret = run_watch_mode(input_paths, output_path, options, debounce_ms, stats ? &stats_format : nullptr);
 
-    return 0;
+    return ret;
 }
 
 static void show_usage()
 {
-    fprintf(stderr, "Usage: make-wavetable-faust <-i wave-file> [-o output-file]\n");
+    fprintf(stderr,
+            "Usage: make-wavetable-faust <-i wave-file|directory>... [-o output-file|directory]\n"
+            "                            [-f faust|binary|wav] [-s table-size] [-c cycles]\n"
+            "                            [-C cache-dir] [-w] [--debounce=ms] [-b]\n"
+            "                            [--auto-size[=threshold-db]] [--morph=frames]\n"
+            "                            [--connect=socket] [--stats[=text|json]]\n"
+            "       make-wavetable-faust -i wave-file -o output-wav --render=event-file\n"
+            "                            [-s table-size] [-c cycles] [--sample-rate=hz]\n"
+            "                            [--threads=count]\n"
+            "       make-wavetable-faust --daemon=socket [--threads=count]\n"
+            "\n"
+            "  -i, --input       sound file or directory of sound files; give several\n"
+            "                    inputs, or a directory, to convert in batch; the\n"
+            "                    channels of a sound file are converted as a bank\n"
+            "  -o, --output      output file, or output directory in batch\n"
+            "  -f, --format      output format (default: faust)\n"
+            "  -s, --table-size  number of samples of each table (default: 2048)\n"
+            "  --auto-size       choose the smallest table, a power of 2 from 256 to the\n"
+            "                    table size, which keeps the harmonics whose energy is\n"
+            "                    above the threshold (default: -60 dB of the total)\n"
+            "  -c, --cycles      number of periods in the sound file (default: 1)\n"
+            "  -C, --cache       directory of the conversion cache\n"
+            "  -w, --watch       regenerate the outputs when the inputs change\n"
+            "  -b, --bank        pack all the inputs in a bank of a single output\n"
+            "  --morph           morph between two inputs in the spectral domain, and\n"
+            "                    pack the frames, including the inputs, in a bank\n"
+            "  --debounce        delay of regeneration after a change (default: 50 ms)\n"
+            "  --connect         convert by requests to a daemon listening on the socket\n"
+            "  --stats           print the time of each stage of the conversions, the\n"
+            "                    memory and the output size, as text or JSON lines;\n"
+            "                    in batch, print also the percentiles, and in watch\n"
+            "                    mode, print for each regeneration\n"
+            "  --daemon          serve conversion requests on a UNIX socket\n"
+            "  --threads         number of threads of the daemon or the rendering\n"
+            "                    (default: all cores)\n"
+            "  --render          play the notes of the file with the wavetable, into a\n"
+            "                    WAV file, and print the real-time factor; each line of\n"
+            "                    the file is: start duration note velocity, in seconds,\n"
+            "                    MIDI note and velocity from 0 to 1 (not 0 to 127), then\n"
+            "                    optionally: vibrato-hz vibrato-cents; the notes end\n"
+            "                    within 600 s\n"
+            "  --sample-rate     sample rate of the rendering (default: 48000)\n");
 }
 
-static int read_file_waveform(const char *path, Waveform &wave)
+static bool parse_table_size(const char *text, uint32_t &size)
 {
-    drwav wav_file;
-    drwav_bool32 wav_init = drwav_init_file(&wav_file, path, nullptr);
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0')
+        return false;
+    // the inverse real FFT requires an even size
+    if (value < 4 || value > (1ul << 24) || (value & 1))
+        return false;
+    size = (uint32_t)value;
+    return true;
+}
 
-    if (!wav_init) {
-        fprintf(stderr, "Cannot open sound file.\n");
-        return 1;
-    }
-    auto wav_file_cleanup = nonstd::make_scope_exit(
-        [&wav_file]() { drwav_uninit(&wav_file); });
+static bool parse_cycles(const char *text, uint32_t &cycles)
+{
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0')
+        return false;
+    if (value < 1 || value > (1ul << 24))
+        return false;
+    cycles = (uint32_t)value;
+    return true;
+}
 
-    if (wav_file.channels != 1) {
-        fprintf(stderr, "Sound data does not contain exactly 1 channel.\n");
-        return 1;
-    }
-    if (wav_file.totalPCMFrameCount > 65536) {
-        fprintf(stderr, "Sound data is too large.\n");
-        return 1;
-    }
-    if (wav_file.totalPCMFrameCount < 4) {
-        fprintf(stderr, "Sound data is too small.\n");
-        return 1;
-    }
-    if (wav_file.totalPCMFrameCount & 1) {
-        fprintf(stderr, "Sound data must have an even size.\n");
-        return 1;
-    }
+static bool parse_milliseconds(const char *text, unsigned &ms)
+{
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0')
+        return false;
+    if (value > 60000)
+        return false;
+    ms = (unsigned)value;
+    return true;
+}
 
-    wave.size = (uint32_t)wav_file.totalPCMFrameCount;
-    wave.data.reset(new float[wave.size]);
+static bool parse_threads(const char *text, unsigned &threads)
+{
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0')
+        return false;
+    if (value < 1 || value > 1024)
+        return false;
+    threads = (unsigned)value;
+    return true;
+}
 
-    if (drwav_read_pcm_frames_f32(&wav_file, wave.size, wave.data.get()) != wave.size) {
-        fprintf(stderr, "Cannot read sound data.\n");
-        return 1;
-    }
+static bool parse_sample_rate(const char *text, double &rate)
+{
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || *end != '\0')
+        return false;
+    if (!(value >= 8000 && value <= 384000))
+        return false;
+    rate = value;
+    return true;
+}
 
-    return 0;
+static bool parse_threshold(const char *text, double &threshold)
+{
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || *end != '\0')
+        return false;
+    if (!(value >= -200 && value <= 0))
+        return false;
+    threshold = value;
+    return true;
 }
 
-static void write_mipmap(FILE *stream, sfz::WavetableMulti &mipmap)
+static bool parse_frames(const char *text, uint32_t &frames)
 {
-    uint32_t tableSize = mipmap.tableSize();
-    fprintf(stream, "tableSize = %u;\n", tableSize);
-    fprintf(stream, "numTables = %u;\n", sfz::MipmapRange::N);
-    fprintf(stream, "firstStartFrequency = %f;\n", sfz::MipmapRange::F1);
-    fprintf(stream, "lastStartFrequency = %f;\n", sfz::MipmapRange::FN);
-    fprintf(stream, "waveData = waveform{\n");
-    for (uint32_t tableNo = 0; tableNo < sfz::MipmapRange::N; ++tableNo) {
-        const nonstd::span<const float> table = mipmap.getTable(tableNo);
-        for (uint32_t i = 0; i < tableSize; ++i) {
-            fprintf(stream, "%s%e", (i > 0) ? ", " : "  ", table[i]);
-        }
-        if (tableNo + 1 < sfz::MipmapRange::N)
-            fprintf(stream, ",");
-        fprintf(stream, "\n");
-    }
-    fprintf(stream, "} : (!, _);\n");
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text || *end != '\0')
+        return false;
+    if (value < 2 || value > 4096)
+        return false;
+    frames = (uint32_t)value;
+    return true;
 }
@@ -0,0 +1,364 @@
+#include "mipmap_output.h"
+#include "dr_wav_library.h"
+#include "sfizz/Wavetables.h"
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+bool parse_output_format(const char *name, OutputFormat &format)
+{
+    if (!strcmp(name, "faust"))
+        format = OutputFormat::Faust;
+    else if (!strcmp(name, "binary"))
+        format = OutputFormat::Binary;
+    else if (!strcmp(name, "wav"))
+        format = OutputFormat::Wav;
+    else
+        return false;
+    return true;
+}
+
+const char *output_format_extension(OutputFormat format)
+{
+    switch (format) {
+    case OutputFormat::Faust:
+        return "lib";
+    case OutputFormat::Binary:
+        return "bin";
+    case OutputFormat::Wav:
+        return "wav";
+    }
+    return "";
+}
+
+BinaryMipmapHeader make_binary_mipmap_header(uint32_t table_size)
+{
+    BinaryMipmapHeader header;
+    memcpy(header.magic, "WTMM", 4);
+    header.version = binary_mipmap_version;
+    header.tableSize = table_size;
+    header.numTables = sfz::MipmapRange::N;
+    header.firstStartFrequency = sfz::MipmapRange::F1;
+    header.lastStartFrequency = sfz::MipmapRange::FN;
+    return header;
+}
+
+//------------------------------------------------------------------------------
+// the binary formats are little-endian, whatever the byte order of the host
+
+static bool host_is_little_endian()
+{
+    const uint32_t one = 1;
+    unsigned char first;
+    memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+static void put_le32(unsigned char *dst, uint32_t value)
+{
+    dst[0] = (unsigned char)value;
+    dst[1] = (unsigned char)(value >> 8);
+    dst[2] = (unsigned char)(value >> 16);
+    dst[3] = (unsigned char)(value >> 24);
+}
+
+static void put_le_float(unsigned char *dst, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    put_le32(dst, bits);
+}
+
+static bool write_le_floats(FILE *stream, nonstd::span<const float> values)
+{
+    if (host_is_little_endian())
+        return fwrite(values.data(), sizeof(float), values.size(), stream) == values.size();
+
+    unsigned char buffer[4096];
+    constexpr size_t chunk = sizeof(buffer) / 4;
+    for (size_t offset = 0; offset < values.size(); offset += chunk) {
+        size_t count = std::min(chunk, values.size() - offset);
+        for (size_t i = 0; i < count; ++i)
+            put_le_float(buffer + 4 * i, values[offset + i]);
+        if (fwrite(buffer, 4, count, stream) != count)
+            return false;
+    }
+    return true;
+}
+
+static bool write_binary_mipmap_header(FILE *stream, const BinaryMipmapHeader &header)
+{
+    unsigned char bytes[24];
+    memcpy(bytes, header.magic, 4);
+    put_le32(bytes + 4, header.version);
+    put_le32(bytes + 8, header.tableSize);
+    put_le32(bytes + 12, header.numTables);
+    put_le_float(bytes + 16, header.firstStartFrequency);
+    put_le_float(bytes + 20, header.lastStartFrequency);
+    return fwrite(bytes, sizeof(bytes), 1, stream) == 1;
+}
+
+static bool write_binary_bank_header(FILE *stream, const BinaryBankHeader &header)
+{
+    unsigned char bytes[16];
+    memcpy(bytes, header.magic, 4);
+    put_le32(bytes + 4, header.version);
+    put_le32(bytes + 8, header.numParts);
+    put_le32(bytes + 12, header.reserved);
+    return fwrite(bytes, sizeof(bytes), 1, stream) == 1;
+}
+
+namespace {
+
+void write_faust_table(FILE *stream, nonstd::span<const float> table, bool last)
+{
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        fprintf(stream, "%s%e", (i > 0) ? ", " : "  ", table[i]);
+    }
+    if (!last)
+        fprintf(stream, ",");
+    fprintf(stream, "\n");
+}
+
+class FaustMipmapWriter : public MipmapWriter {
+public:
+    explicit FaustMipmapWriter(FILE *stream) : stream_(stream) {}
+
+    bool begin(uint32_t table_size) override
+    {
+        FILE *stream = stream_;
+        fprintf(stream, "tableSize = %u;\n", table_size);
+        fprintf(stream, "numTables = %u;\n", sfz::MipmapRange::N);
+        fprintf(stream, "firstStartFrequency = %f;\n", sfz::MipmapRange::F1);
+        fprintf(stream, "lastStartFrequency = %f;\n", sfz::MipmapRange::FN);
+        fprintf(stream, "waveData = waveform{\n");
+        return true;
+    }
+
+    void write_table(uint32_t table_no, nonstd::span<const float> table) override
+    {
+        write_faust_table(stream_, table, table_no + 1 == sfz::MipmapRange::N);
+    }
+
+    void end() override
+    {
+        fprintf(stream_, "} : (!, _);\n");
+    }
+
+private:
+    FILE *stream_ = nullptr;
+};
+
+//------------------------------------------------------------------------------
+class BinaryMipmapWriter : public MipmapWriter {
+public:
+    explicit BinaryMipmapWriter(FILE *stream) : stream_(stream) {}
+
+    bool begin(uint32_t table_size) override
+    {
+        return write_binary_mipmap_header(stream_, make_binary_mipmap_header(table_size));
+    }
+
+    void write_table(uint32_t, nonstd::span<const float> table) override
+    {
+        write_le_floats(stream_, table);
+    }
+
+    void end() override
+    {
+    }
+
+private:
+    FILE *stream_ = nullptr;
+};
+
+//------------------------------------------------------------------------------
+size_t on_wav_write(void *user_data, const void *data, size_t size)
+{
+    return fwrite(data, 1, size, (FILE *)user_data);
+}
+
+class WavMipmapWriter : public MipmapWriter {
+public:
+    explicit WavMipmapWriter(FILE *stream) : stream_(stream) {}
+
+    ~WavMipmapWriter()
+    {
+        if (initialized_)
+            drwav_uninit(&wav_);
+    }
+
+    bool begin(uint32_t table_size) override
+    {
+        drwav_data_format format;
+        format.container = drwav_container_riff;
+        format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+        format.channels = 1;
+        format.sampleRate = 44100;
+        format.bitsPerSample = 32;
+
+        // the tables are concatenated in a single channel
+        drwav_uint64 frames = (drwav_uint64)table_size * sfz::MipmapRange::N;
+        initialized_ = drwav_init_write_sequential_pcm_frames(
+            &wav_, &format, frames, &on_wav_write, stream_, nullptr);
+        return initialized_;
+    }
+
+    void write_table(uint32_t, nonstd::span<const float> table) override
+    {
+        drwav_write_pcm_frames(&wav_, table.size(), table.data());
+    }
+
+    void end() override
+    {
+        if (initialized_) {
+            drwav_uninit(&wav_);
+            initialized_ = false;
+        }
+    }
+
+private:
+    FILE *stream_ = nullptr;
+    drwav wav_;
+    bool initialized_ = false;
+};
+
+} // namespace
+
+//------------------------------------------------------------------------------
+std::unique_ptr<MipmapWriter> create_mipmap_writer(OutputFormat format, FILE *stream)
+{
+    switch (format) {
+    case OutputFormat::Faust:
+        return std::unique_ptr<MipmapWriter>(new FaustMipmapWriter(stream));
+    case OutputFormat::Binary:
+        return std::unique_ptr<MipmapWriter>(new BinaryMipmapWriter(stream));
+    case OutputFormat::Wav:
+        return std::unique_ptr<MipmapWriter>(new WavMipmapWriter(stream));
+    }
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+static bool write_interleaved_wav_bank(FILE *stream, const std::vector<const sfz::WavetableMulti *> &parts)
+{
+    const uint32_t num_parts = (uint32_t)parts.size();
+    const uint32_t table_size = parts[0]->tableSize();
+
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+    format.channels = num_parts;
+    format.sampleRate = 44100;
+    format.bitsPerSample = 32;
+
+    drwav wav;
+    drwav_uint64 frames = (drwav_uint64)table_size * sfz::MipmapRange::N;
+    if (!drwav_init_write_sequential_pcm_frames(&wav, &format, frames, &on_wav_write, stream, nullptr))
+        return false;
+
+    std::vector<float> block((size_t)table_size * num_parts);
+    for (uint32_t m = 0; m < sfz::MipmapRange::N; ++m) {
+        for (uint32_t p = 0; p < num_parts; ++p) {
+            nonstd::span<const float> table = parts[p]->getTable(m);
+            for (uint32_t i = 0; i < table_size; ++i)
+                block[(size_t)i * num_parts + p] = table[i];
+        }
+        drwav_write_pcm_frames(&wav, table_size, block.data());
+    }
+
+    drwav_uninit(&wav);
+    return true;
+}
+
+static bool write_packed_faust_bank(FILE *stream, const std::vector<const sfz::WavetableMulti *> &parts)
+{
+    const uint32_t num_parts = (uint32_t)parts.size();
+
+    fprintf(stream, "tableSize = %u;\n", parts[0]->tableSize());
+    fprintf(stream, "numTables = %u;\n", sfz::MipmapRange::N);
+    fprintf(stream, "numBanks = %u;\n", num_parts);
+    fprintf(stream, "firstStartFrequency = %f;\n", sfz::MipmapRange::F1);
+    fprintf(stream, "lastStartFrequency = %f;\n", sfz::MipmapRange::FN);
+    fprintf(stream, "waveData = waveform{\n");
+    for (uint32_t p = 0; p < num_parts; ++p) {
+        for (uint32_t m = 0; m < sfz::MipmapRange::N; ++m) {
+            bool last = p + 1 == num_parts && m + 1 == sfz::MipmapRange::N;
+            write_faust_table(stream, parts[p]->getTable(m), last);
+        }
+    }
+    fprintf(stream, "} : (!, _);\n");
+    return true;
+}
+
+static bool write_packed_wav_bank(FILE *stream, const std::vector<const sfz::WavetableMulti *> &parts)
+{
+    const uint32_t num_parts = (uint32_t)parts.size();
+    const uint32_t table_size = parts[0]->tableSize();
+
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+    format.channels = 1;
+    format.sampleRate = 44100;
+    format.bitsPerSample = 32;
+
+    drwav wav;
+    drwav_uint64 frames = (drwav_uint64)table_size * sfz::MipmapRange::N * num_parts;
+    if (!drwav_init_write_sequential_pcm_frames(&wav, &format, frames, &on_wav_write, stream, nullptr))
+        return false;
+
+    for (uint32_t p = 0; p < num_parts; ++p) {
+        for (uint32_t m = 0; m < sfz::MipmapRange::N; ++m)
+            drwav_write_pcm_frames(&wav, table_size, parts[p]->getTable(m).data());
+    }
+
+    drwav_uninit(&wav);
+    return true;
+}
+
+bool write_mipmap_bank(OutputFormat format, FILE *stream, const std::vector<const sfz::WavetableMulti *> &parts,
+                       BankLayout layout)
+{
+    if (parts.empty())
+        return false;
+
+    const uint32_t num_parts = (uint32_t)parts.size();
+    const uint32_t table_size = parts[0]->tableSize();
+    for (const sfz::WavetableMulti *part : parts) {
+        if (part->tableSize() != table_size)
+            return false;
+    }
+
+    if (format == OutputFormat::Faust && layout == BankLayout::Packed)
+        return write_packed_faust_bank(stream, parts);
+    if (format == OutputFormat::Wav && layout == BankLayout::Packed)
+        return write_packed_wav_bank(stream, parts);
+    if (format == OutputFormat::Wav)
+        return write_interleaved_wav_bank(stream, parts);
+
+    if (format == OutputFormat::Binary) {
+        BinaryBankHeader header;
+        memcpy(header.magic, "WTMB", 4);
+        header.version = binary_bank_version;
+        header.numParts = num_parts;
+        header.reserved = 0;
+        if (!write_binary_bank_header(stream, header))
+            return false;
+    }
+
+    std::unique_ptr<MipmapWriter> writer = create_mipmap_writer(format, stream);
+    for (uint32_t p = 0; p < num_parts; ++p) {
+        if (format == OutputFormat::Faust)
+            fprintf(stream, "%schannel%u = environment {\n", (p > 0) ? "\n" : "", p);
+        if (!writer->begin(table_size))
+            return false;
+        for (uint32_t m = 0; m < sfz::MipmapRange::N; ++m)
+            writer->write_table(m, parts[p]->getTable(m));
+        writer->end();
+        if (format == OutputFormat::Faust)
+            fprintf(stream, "};\n");
+    }
+
+    return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <nonstd/span.hpp>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+enum class OutputFormat {
+    Faust,
+    Binary,
+    Wav,
+};
+
+// header of the binary format, followed by `numTables * tableSize` samples
+// in 32-bit float; the files have all fields in the little-endian byte
+// order, and the structure has them in the byte order of the host.
+struct BinaryMipmapHeader {
+    char magic[4]; // "WTMM"
+    uint32_t version;
+    uint32_t tableSize;
+    uint32_t numTables;
+    float firstStartFrequency;
+    float lastStartFrequency;
+};
+
+static constexpr uint32_t binary_mipmap_version = 1;
+
+// header of the binary format of a bank, followed by `numParts` complete
+// binary mipmaps, each with its own header.
+struct BinaryBankHeader {
+    char magic[4]; // "WTMB"
+    uint32_t version;
+    uint32_t numParts;
+    uint32_t reserved;
+};
+
+static constexpr uint32_t binary_bank_version = 1;
+
+// get the header of a binary mipmap with tables of the given size
+BinaryMipmapHeader make_binary_mipmap_header(uint32_t table_size);
+
+/**
+   Writes the tables of a mipmap to a stream, in order, as they get generated.
+ */
+namespace sfz { class WavetableMulti; }
+
+class MipmapWriter {
+public:
+    virtual ~MipmapWriter() {}
+    virtual bool begin(uint32_t table_size) = 0;
+    virtual void write_table(uint32_t table_no, nonstd::span<const float> table) = 0;
+    virtual void end() = 0;
+};
+
+bool parse_output_format(const char *name, OutputFormat &format);
+const char *output_format_extension(OutputFormat format);
+std::unique_ptr<MipmapWriter> create_mipmap_writer(OutputFormat format, FILE *stream);
+
+enum class BankLayout {
+    // each part is written on its own: an environment `channel<N>` in Faust,
+    // and a channel in WAV
+    Separate,
+    // all the parts are written one after another as a single set of tables,
+    // which is `numBanks` mipmaps in Faust, and a single channel in WAV
+    Packed,
+};
+
+/**
+   Writes several mipmaps with tables of the same size, as a bank.
+   In binary, the complete mipmaps follow a bank header, in both layouts.
+ */
+bool write_mipmap_bank(OutputFormat format, FILE *stream, const std::vector<const sfz::WavetableMulti *> &parts,
+                       BankLayout layout = BankLayout::Separate);
@@ -0,0 +1,306 @@
+#include "render_mode.h"
+#include "dr_wav_library.h"
+#include "sfizz/Wavetables.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// a note of the event list, with optional vibrato
+struct NoteEvent {
+    double start = 0;
+    double duration = 0;
+    // MIDI note number, which may be fractional
+    double note = 69;
+    float velocity = 1;
+    double vibrato_rate = 0;
+    double vibrato_cents = 0;
+};
+
+// the frames of the mix which one lock guards
+static constexpr size_t mix_region_frames = 4096;
+
+/**
+   The mix of the notes of all the workers. The workers add their notes a
+   block at a time, under the locks of the regions which the block covers,
+   so the notes which overlap in time may be rendered by any workers.
+ */
+class SharedMix {
+public:
+    explicit SharedMix(size_t frames)
+        : frames_(frames, 0.0f), locks_((frames + mix_region_frames - 1) / mix_region_frames)
+    {
+    }
+
+    size_t size() const { return frames_.size(); }
+    const std::vector<float> &frames() const { return frames_; }
+
+    // add a block to the frames from the given start, which must be within
+    // the mix
+    void add(size_t start, const float *block, size_t count)
+    {
+        while (count > 0) {
+            size_t region = start / mix_region_frames;
+            size_t n = std::min(count, (region + 1) * mix_region_frames - start);
+            std::lock_guard<std::mutex> lock(locks_[region]);
+            float *dst = frames_.data() + start;
+            for (size_t i = 0; i < n; ++i)
+                dst[i] += block[i];
+            start += n;
+            block += n;
+            count -= n;
+        }
+    }
+
+private:
+    std::vector<float> frames_;
+    std::vector<std::mutex> locks_;
+};
+
+} // namespace
+
+// the latest end of a note, in seconds, which bounds the memory of the mix
+static constexpr double max_render_time = 600.0;
+
+// times of the envelope of the notes, which prevents clicks
+static constexpr double attack_time = 0.005;
+static constexpr double release_time = 0.020;
+
+static constexpr unsigned render_block_size = 256;
+
+// the vibrato is computed at this interval of frames, and interpolated
+static constexpr unsigned control_interval = 16;
+
+// read the events, one per line:
+//     start-seconds duration-seconds note velocity [vibrato-hz vibrato-cents]
+// the velocity is a gain from 0 to 1, not a MIDI velocity. empty lines, and
+// lines starting with '#', are ignored. the notes must end within
+// `max_render_time`.
+static bool read_note_events(const char *path, std::vector<NoteEvent> &events)
+{
+    FILE *stream = fopen(path, "r");
+    if (!stream) {
+        fprintf(stderr, "Cannot open the event file.\n");
+        return false;
+    }
+
+    char line[1024];
+    for (unsigned line_no = 1; fgets(line, sizeof(line), stream); ++line_no) {
+        const char *text = line + strspn(line, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\r' || *text == '\0')
+            continue;
+
+        NoteEvent ev;
+        int count = sscanf(text, "%lf %lf %lf %f %lf %lf", &ev.start, &ev.duration, &ev.note,
+                           &ev.velocity, &ev.vibrato_rate, &ev.vibrato_cents);
+        bool valid = (count == 4 || count == 6) && ev.start >= 0 && ev.duration > 0 &&
+            ev.start + ev.duration <= max_render_time && ev.note >= 0 && ev.note <= 127 &&
+            ev.velocity >= 0 && ev.velocity <= 1 && ev.vibrato_rate >= 0;
+        if (!valid) {
+            fprintf(stderr, "Invalid note event at line %u.\n", line_no);
+            fclose(stream);
+            return false;
+        }
+        events.push_back(ev);
+    }
+
+    fclose(stream);
+    return true;
+}
+
+static double note_frequency(double note)
+{
+    return 440.0 * std::exp2((note - 69.0) / 12.0);
+}
+
+// the largest number of notes which sound at once, with their releases
+static size_t max_polyphony(const std::vector<NoteEvent> &events)
+{
+    std::vector<std::pair<double, int>> edges;
+    for (const NoteEvent &ev : events) {
+        edges.emplace_back(ev.start, +1);
+        edges.emplace_back(ev.start + ev.duration + release_time, -1);
+    }
+    // the ends sort before the starts at the same time
+    std::sort(edges.begin(), edges.end());
+
+    long current = 0, peak = 0;
+    for (const auto &edge : edges) {
+        current += edge.second;
+        peak = std::max(peak, current);
+    }
+    return (size_t)peak;
+}
+
+/**
+   Render a note and add it to the mix, a block at a time. The oscillator is
+   reused by the notes of a worker, and it gets reset at the start of each
+   note.
+ */
+static void render_note(const NoteEvent &ev, double sample_rate, sfz::WavetableOscillator &osc, SharedMix &mix)
+{
+    const size_t mix_frames = mix.size();
+    const size_t start = (size_t)std::lround(ev.start * sample_rate);
+    const size_t sustain_frames = (size_t)std::lround(ev.duration * sample_rate);
+    const size_t attack_frames = std::max<size_t>(1, (size_t)(attack_time * sample_rate));
+    const size_t release_frames = std::max<size_t>(1, (size_t)(release_time * sample_rate));
+    if (start >= mix_frames)
+        return;
+    const size_t frames = std::min(sustain_frames + release_frames, mix_frames - start);
+
+    const double frequency = note_frequency(ev.note);
+    const bool vibrato = ev.vibrato_rate > 0 && ev.vibrato_cents != 0;
+    const double vibrato_step = 2.0 * M_PI * ev.vibrato_rate / sample_rate;
+    const double vibrato_octaves = ev.vibrato_cents / 1200.0;
+
+    float freqs[render_block_size];
+    float output[render_block_size];
+
+    osc.clear();
+
+    for (size_t offset = 0; offset < frames;) {
+        unsigned count = (unsigned)std::min<size_t>(render_block_size, frames - offset);
+
+        if (vibrato) {
+            auto vibrato_at = [&](size_t t) -> float {
+                return (float)(frequency * std::exp2(vibrato_octaves * std::sin(vibrato_step * t)));
+            };
+            float f1 = vibrato_at(offset);
+            for (unsigned i = 0; i < count; i += control_interval) {
+                float f2 = vibrato_at(offset + i + control_interval);
+                unsigned n = std::min(control_interval, count - i);
+                for (unsigned j = 0; j < n; ++j)
+                    freqs[i + j] = f1 + (f2 - f1) * j / control_interval;
+                f1 = f2;
+            }
+            osc.processModulated(freqs, output, count);
+        }
+        else
+            osc.process((float)frequency, output, count);
+
+        for (unsigned i = 0; i < count; ++i) {
+            size_t t = offset + i;
+            float env = 1.0f;
+            if (t < attack_frames)
+                env = (float)t / attack_frames;
+            if (t >= sustain_frames)
+                env *= 1.0f - (float)(t - sustain_frames) / release_frames;
+            output[i] *= ev.velocity * env;
+        }
+        mix.add(start + offset, output, count);
+
+        offset += count;
+    }
+}
+
+static bool write_wav_file(const char *path, const std::vector<float> &mix, double sample_rate)
+{
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+    format.channels = 1;
+    format.sampleRate = (drwav_uint32)sample_rate;
+    format.bitsPerSample = 32;
+
+    drwav wav;
+    if (!drwav_init_file_write_sequential_pcm_frames(&wav, path, &format, mix.size(), nullptr))
+        return false;
+    bool written = drwav_write_pcm_frames(&wav, mix.size(), mix.data()) == mix.size();
+    drwav_uninit(&wav);
+    return written;
+}
+
+int run_render_mode(const char *wave_path, const char *events_path, const char *output_path,
+                    const ConversionOptions &render_conversion, const RenderOptions &render_options)
+{
+    Waveform raw;
+    int ret = read_file_waveform(wave_path, raw);
+    if (ret != 0)
+        return ret;
+    if (raw.channels != 1) {
+        fprintf(stderr, "The render mode takes a sound file of a single channel.\n");
+        return 1;
+    }
+    ConversionOptions options = render_conversion;
+    if (raw.size < 2 * (size_t)options.cycles) {
+        fprintf(stderr, "Sound data is too small for the number of cycles.\n");
+        return 1;
+    }
+
+    std::vector<NoteEvent> events;
+    if (!read_note_events(events_path, events))
+        return 1;
+    if (events.empty()) {
+        fprintf(stderr, "There are no note events to render.\n");
+        return 1;
+    }
+
+    apply_auto_size(raw, wave_path, options);
+    const sfz::WavetableMulti wave = sfz::WavetableMulti::createFromAudioData(
+        raw.channel(0), options.amplitude, options.table_size, options.ref_sample_rate, options.cycles);
+
+    const double sample_rate = render_options.sample_rate;
+    double end_time = 0;
+    for (const NoteEvent &ev : events)
+        end_time = std::max(end_time, ev.start + ev.duration + release_time);
+    const size_t total_frames = (size_t)std::ceil(end_time * sample_rate);
+
+    unsigned num_threads = render_options.num_threads;
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = (unsigned)std::min<size_t>(num_threads, events.size());
+
+    std::unique_ptr<SharedMix> mix;
+    try {
+        mix.reset(new SharedMix(total_frames));
+    }
+    catch (std::bad_alloc &) {
+        fprintf(stderr, "Cannot allocate the mix of %.3f s of audio.\n", end_time);
+        return 1;
+    }
+
+    // each worker renders its notes, every N-th of the list, and adds them
+    // to the common mix
+    auto work = [&](unsigned worker) {
+        sfz::WavetableOscillator osc;
+        osc.init(sample_rate);
+        osc.setWavetable(&wave);
+
+        for (size_t i = worker; i < events.size(); i += num_threads)
+            render_note(events[i], sample_rate, osc, *mix);
+    };
+
+    auto render_start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; ++t)
+        threads.emplace_back(work, t);
+    work(0);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    std::chrono::duration<double> render_time = std::chrono::steady_clock::now() - render_start;
+
+    if (!write_wav_file(output_path, mix->frames(), sample_rate)) {
+        fprintf(stderr, "Cannot write output file.\n");
+        return 1;
+    }
+
+    // the real-time factor is the time of rendering over the duration of
+    // the audio; below 1, the rendering is faster than real time
+    const double audio_seconds = total_frames / sample_rate;
+    const double rtf = render_time.count() / audio_seconds;
+    fprintf(stderr,
+            "Rendered %zu notes, at most %zu at once, to %.3f s of audio on %u threads in %.3f s\n"
+            "Real-time factor: %.4f (%.1fx real time)\n",
+            events.size(), max_polyphony(events), audio_seconds, num_threads, render_time.count(),
+            rtf, (rtf > 0) ? (1.0 / rtf) : 0.0);
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "conversion.h"
+
+struct RenderOptions {
+    double sample_rate = 48000.0;
+    // number of worker threads, or 0 for all the cores
+    unsigned num_threads = 0;
+};
+
+// play the note events of a file with the wavetable of a sound file, and
+// mix them into a WAV file; each worker thread owns a subset of the voices.
+// print the real-time factor of the rendering.
+int run_render_mode(const char *wave_path, const char *events_path, const char *output_path,
+                    const ConversionOptions &options, const RenderOptions &render_options);
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+namespace sfz {
+
+/**
+   A standard allocator which returns memory aligned on a boundary of
+   `Alignment` bytes, for use with aligned vector loads.
+
+   The alignment must be a power of two, at least the size of a pointer.
+ */
+template <class T, std::size_t Alignment>
+class AlignedAllocator {
+public:
+    typedef T value_type;
+
+    static_assert((Alignment & (Alignment - 1)) == 0, "The alignment must be a power of two");
+    static_assert(Alignment >= sizeof(void*), "The alignment must be at least the size of a pointer");
+
+    template <class U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() noexcept {}
+
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t count)
+    {
+        if (count > (SIZE_MAX - Alignment) / sizeof(T))
+            throw std::bad_alloc();
+
+        // over-allocate, and store the original pointer in front of the block;
+        // the memory comes from the global operator new, so that it is
+        // accounted by any replacement of the operator
+        void* raw = ::operator new(count * sizeof(T) + Alignment);
+
+        std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(raw) + Alignment;
+        addr &= ~static_cast<std::uintptr_t>(Alignment - 1);
+
+        void** aligned = reinterpret_cast<void**>(addr);
+        aligned[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept
+    {
+        if (ptr)
+            ::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+    }
+
+    template <class U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <class U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+} // namespace sfz
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "EpochReclaimer.h"
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+
+namespace sfz {
+
+constexpr unsigned EpochReclaimer::maxReaders;
+constexpr uint64_t EpochReclaimer::idleEpoch;
+
+EpochReclaimer::~EpochReclaimer()
+{
+    for (Retired& retired : _retired)
+        retired.deleter();
+}
+
+int EpochReclaimer::addReader()
+{
+    for (unsigned reader = 0; reader < maxReaders; ++reader) {
+        bool used = false;
+        if (_readers[reader].used.compare_exchange_strong(used, true))
+            return static_cast<int>(reader);
+    }
+    return -1;
+}
+
+void EpochReclaimer::removeReader(unsigned reader)
+{
+    assert(reader < maxReaders);
+    assert(_readers[reader].epoch.load() == idleEpoch);
+    _readers[reader].used.store(false);
+}
+
+void EpochReclaimer::enter(unsigned reader)
+{
+    assert(reader < maxReaders);
+    // the epoch gets visible before any access to the shared objects, which
+    // requires the sequential consistency of the store
+    _readers[reader].epoch.store(_epoch.load());
+}
+
+void EpochReclaimer::leave(unsigned reader)
+{
+    assert(reader < maxReaders);
+    _readers[reader].epoch.store(idleEpoch, std::memory_order_release);
+}
+
+void EpochReclaimer::retire(std::function<void()> deleter)
+{
+    // a reader which entered before this point may hold the object, and its
+    // epoch is at most the one before the increment; a reader which enters
+    // after it has a later epoch, and cannot find the object
+    Retired retired;
+    retired.epoch = _epoch.fetch_add(1);
+    retired.deleter = std::move(deleter);
+
+    std::lock_guard<std::mutex> lock(_retiredMutex);
+    _retired.push_back(std::move(retired));
+}
+
+size_t EpochReclaimer::reclaim()
+{
+    std::vector<Retired> reclaimable;
+    size_t remaining;
+
+    {
+        std::lock_guard<std::mutex> lock(_retiredMutex);
+        const uint64_t oldest = oldestReaderEpoch();
+        auto it = std::partition(_retired.begin(), _retired.end(),
+            [oldest](const Retired& retired) { return retired.epoch >= oldest; });
+        std::move(it, _retired.end(), std::back_inserter(reclaimable));
+        _retired.erase(it, _retired.end());
+        remaining = _retired.size();
+    }
+
+    // the deleters run outside of the lock
+    for (Retired& retired : reclaimable)
+        retired.deleter();
+
+    return remaining;
+}
+
+uint64_t EpochReclaimer::oldestReaderEpoch() const
+{
+    uint64_t oldest = _epoch.load();
+    for (const ReaderSlot& slot : _readers) {
+        uint64_t epoch = slot.epoch.load();
+        if (epoch != idleEpoch)
+            oldest = std::min(oldest, epoch);
+    }
+    return oldest;
+}
+
+} // namespace sfz
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+namespace sfz {
+
+/**
+   A deferred reclamation of shared objects, based on epochs.
+
+   Readers, such as audio threads, surround their accesses with `enter` and
+   `leave`, which are wait-free. A writer which unlinks an object from the
+   shared structure retires it, and the object gets deleted by `reclaim`
+   once every reader has left or entered again; the deletion never happens
+   on a reader thread.
+ */
+class EpochReclaimer {
+public:
+    // maximum number of readers registered at once
+    static constexpr unsigned maxReaders = 64;
+
+    EpochReclaimer() = default;
+    // delete all the retired objects; no reader may be inside
+    ~EpochReclaimer();
+
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    // register a reader, and get its number, or -1 if there are too many
+    int addReader();
+
+    // unregister a reader, which must not be inside
+    void removeReader(unsigned reader);
+
+    // start accessing the shared objects; wait-free
+    void enter(unsigned reader);
+
+    // stop accessing the shared objects; wait-free
+    void leave(unsigned reader);
+
+    // retire an object after unlinking it, with the function which deletes it
+    void retire(std::function<void()> deleter);
+
+    template <class T>
+    void retire(const T* object)
+    {
+        retire([object]() { delete object; });
+    }
+
+    // delete the retired objects which no reader can access, and get the
+    // number of objects which remain retired
+    size_t reclaim();
+
+private:
+    // epoch of a reader inside, or idle
+    static constexpr uint64_t idleEpoch = 0;
+
+    // a slot per reader, on its own cache line
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch { idleEpoch };
+        std::atomic<bool> used { false };
+    };
+
+    struct Retired {
+        uint64_t epoch = 0;
+        std::function<void()> deleter;
+    };
+
+    // the oldest epoch of the readers inside, or the current one
+    uint64_t oldestReaderEpoch() const;
+
+    std::atomic<uint64_t> _epoch { 1 };
+    ReaderSlot _readers[maxReaders];
+
+    std::mutex _retiredMutex;
+    std::vector<Retired> _retired;
+};
+
+} // namespace sfz
@@ -0,0 +1,510 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "FFT.h"
+#include "AlignedAllocator.h"
+#include <kiss_fft.h>
+#include <kiss_fftr.h>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SFZ_FFT_SSE2 1
+#endif
+
+static_assert(sizeof(kiss_fft_scalar) == sizeof(float), "kissfft must be built with float");
+
+namespace sfz {
+
+FFTBackend defaultFFTBackend()
+{
+#if defined(SFZ_FFT_BACKEND_KISSFFT)
+    return FFTBackend::KissFFT;
+#else
+    return FFTBackend::Radix2;
+#endif
+}
+
+const char* fftBackendName(FFTBackend backend)
+{
+    switch (backend) {
+    case FFTBackend::KissFFT:
+        return "kissfft";
+    case FFTBackend::Radix2:
+        return "radix2";
+    }
+    return "";
+}
+
+static bool isPowerOfTwo(size_t n)
+{
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+typedef std::vector<float, AlignedAllocator<float, 16>> AlignedFloats;
+
+//------------------------------------------------------------------------------
+/**
+ * @brief Radix-2 transform of the Stockham kind, on separate arrays of real
+ * and imaginary parts, which lets the butterflies operate on vectors.
+ */
+class Radix2Transform {
+public:
+    explicit Radix2Transform(size_t size)
+        : _size(size), _twRe(size / 2), _twIm(size / 2)
+    {
+        for (size_t k = 0; k < size / 2; ++k) {
+            double phi = -2.0 * M_PI * k / size;
+            _twRe[k] = static_cast<float>(std::cos(phi));
+            _twIm[k] = static_cast<float>(std::sin(phi));
+        }
+        for (AlignedFloats& buffer : _work)
+            buffer.resize(size);
+    }
+
+    void transform(const std::complex<float>* input, std::complex<float>* output, bool inverse)
+    {
+        const size_t size = _size;
+        float* re = _work[0].data();
+        float* im = _work[1].data();
+        float* tmpRe = _work[2].data();
+        float* tmpIm = _work[3].data();
+
+        // the inverse is the conjugate of the forward transform of the conjugate
+        const float sign = inverse ? -1.0f : 1.0f;
+        for (size_t i = 0; i < size; ++i) {
+            re[i] = input[i].real();
+            im[i] = sign * input[i].imag();
+        }
+
+        // at each stage, the sequence length halves and the stride doubles
+        for (size_t n = size, s = 1; n > 1; n /= 2, s *= 2) {
+            const size_t m = n / 2;
+            if (s == 1) {
+                firstStage(re, im, tmpRe, tmpIm, m);
+                std::swap(re, tmpRe);
+                std::swap(im, tmpIm);
+                continue;
+            }
+            for (size_t p = 0; p < m; ++p) {
+                const float wr = _twRe[p * s];
+                const float wi = _twIm[p * s];
+                butterflies(
+                    re + s * p, im + s * p, re + s * (p + m), im + s * (p + m),
+                    tmpRe + s * 2 * p, tmpIm + s * 2 * p,
+                    tmpRe + s * (2 * p + 1), tmpIm + s * (2 * p + 1),
+                    wr, wi, s);
+            }
+            std::swap(re, tmpRe);
+            std::swap(im, tmpIm);
+        }
+
+        for (size_t i = 0; i < size; ++i)
+            output[i] = std::complex<float>(re[i], sign * im[i]);
+    }
+
+private:
+    // the stage of stride 1, where the twiddles are contiguous and the
+    // outputs are interleaved
+    void firstStage(const float* re, const float* im, float* outRe, float* outIm, size_t m)
+    {
+        const float* twRe = _twRe.data();
+        const float* twIm = _twIm.data();
+        size_t p = 0;
+
+#if defined(SFZ_FFT_SSE2)
+        for (; p + 4 <= m; p += 4) {
+            __m128 ar = _mm_loadu_ps(re + p);
+            __m128 ai = _mm_loadu_ps(im + p);
+            __m128 br = _mm_loadu_ps(re + p + m);
+            __m128 bi = _mm_loadu_ps(im + p + m);
+            __m128 wr = _mm_loadu_ps(twRe + p);
+            __m128 wi = _mm_loadu_ps(twIm + p);
+            __m128 xr = _mm_add_ps(ar, br);
+            __m128 xi = _mm_add_ps(ai, bi);
+            __m128 dr = _mm_sub_ps(ar, br);
+            __m128 di = _mm_sub_ps(ai, bi);
+            __m128 yr = _mm_sub_ps(_mm_mul_ps(dr, wr), _mm_mul_ps(di, wi));
+            __m128 yi = _mm_add_ps(_mm_mul_ps(dr, wi), _mm_mul_ps(di, wr));
+            _mm_storeu_ps(outRe + 2 * p, _mm_unpacklo_ps(xr, yr));
+            _mm_storeu_ps(outRe + 2 * p + 4, _mm_unpackhi_ps(xr, yr));
+            _mm_storeu_ps(outIm + 2 * p, _mm_unpacklo_ps(xi, yi));
+            _mm_storeu_ps(outIm + 2 * p + 4, _mm_unpackhi_ps(xi, yi));
+        }
+#endif
+
+        for (; p < m; ++p) {
+            float dr = re[p] - re[p + m];
+            float di = im[p] - im[p + m];
+            outRe[2 * p] = re[p] + re[p + m];
+            outIm[2 * p] = im[p] + im[p + m];
+            outRe[2 * p + 1] = dr * twRe[p] - di * twIm[p];
+            outIm[2 * p + 1] = dr * twIm[p] + di * twRe[p];
+        }
+    }
+
+    static void butterflies(
+        const float* aRe, const float* aIm, const float* bRe, const float* bIm,
+        float* xRe, float* xIm, float* yRe, float* yIm,
+        float wr, float wi, size_t count)
+    {
+        size_t q = 0;
+
+#if defined(SFZ_FFT_SSE2)
+        const __m128 vwr = _mm_set1_ps(wr);
+        const __m128 vwi = _mm_set1_ps(wi);
+        for (; q + 4 <= count; q += 4) {
+            __m128 ar = _mm_loadu_ps(aRe + q);
+            __m128 ai = _mm_loadu_ps(aIm + q);
+            __m128 br = _mm_loadu_ps(bRe + q);
+            __m128 bi = _mm_loadu_ps(bIm + q);
+            __m128 dr = _mm_sub_ps(ar, br);
+            __m128 di = _mm_sub_ps(ai, bi);
+            _mm_storeu_ps(xRe + q, _mm_add_ps(ar, br));
+            _mm_storeu_ps(xIm + q, _mm_add_ps(ai, bi));
+            _mm_storeu_ps(yRe + q, _mm_sub_ps(_mm_mul_ps(dr, vwr), _mm_mul_ps(di, vwi)));
+            _mm_storeu_ps(yIm + q, _mm_add_ps(_mm_mul_ps(dr, vwi), _mm_mul_ps(di, vwr)));
+        }
+#endif
+
+        for (; q < count; ++q) {
+            float dr = aRe[q] - bRe[q];
+            float di = aIm[q] - bIm[q];
+            xRe[q] = aRe[q] + bRe[q];
+            xIm[q] = aIm[q] + bIm[q];
+            yRe[q] = dr * wr - di * wi;
+            yIm[q] = dr * wi + di * wr;
+        }
+    }
+
+private:
+    size_t _size = 0;
+    AlignedFloats _twRe;
+    AlignedFloats _twIm;
+    AlignedFloats _work[4];
+};
+
+//------------------------------------------------------------------------------
+struct ComplexFFT::Impl {
+    size_t size = 0;
+    bool inverse = false;
+    FFTBackend backend = FFTBackend::KissFFT;
+    kiss_fft_cfg kissCfg = nullptr;
+    std::unique_ptr<Radix2Transform> radix2;
+};
+
+ComplexFFT::ComplexFFT(size_t size, bool inverse, FFTBackend backend)
+    : _impl(new Impl)
+{
+    Impl& impl = *_impl;
+    impl.size = size;
+    impl.inverse = inverse;
+
+    if (backend == FFTBackend::Radix2 && isPowerOfTwo(size)) {
+        impl.backend = FFTBackend::Radix2;
+        impl.radix2.reset(new Radix2Transform(size));
+    }
+    else {
+        impl.backend = FFTBackend::KissFFT;
+        impl.kissCfg = kiss_fft_alloc(size, inverse, nullptr, nullptr);
+        if (!impl.kissCfg)
+            throw std::bad_alloc();
+    }
+}
+
+ComplexFFT::~ComplexFFT()
+{
+    kiss_fft_free(_impl->kissCfg);
+}
+
+size_t ComplexFFT::size() const
+{
+    return _impl->size;
+}
+
+FFTBackend ComplexFFT::backend() const
+{
+    return _impl->backend;
+}
+
+void ComplexFFT::transform(const std::complex<float>* input, std::complex<float>* output)
+{
+    Impl& impl = *_impl;
+
+    if (impl.radix2)
+        impl.radix2->transform(input, output, impl.inverse);
+    else
+        kiss_fft(impl.kissCfg,
+            reinterpret_cast<const kiss_fft_cpx*>(input),
+            reinterpret_cast<kiss_fft_cpx*>(output));
+}
+
+//------------------------------------------------------------------------------
+struct RealFFT::Impl {
+    size_t size = 0;
+    FFTBackend backend = FFTBackend::KissFFT;
+    kiss_fftr_cfg kissForward = nullptr;
+    kiss_fftr_cfg kissInverse = nullptr;
+    // a complex transform of half size, with the twiddles to separate the
+    // spectra of even and odd elements
+    std::unique_ptr<ComplexFFT> halfForward;
+    std::unique_ptr<ComplexFFT> halfInverse;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<std::complex<float>> work;
+};
+
+RealFFT::RealFFT(size_t size, FFTBackend backend)
+    : _impl(new Impl)
+{
+    Impl& impl = *_impl;
+    impl.size = size;
+
+    if (backend == FFTBackend::Radix2 && isPowerOfTwo(size) && size >= 4) {
+        const size_t half = size / 2;
+        impl.backend = FFTBackend::Radix2;
+        impl.halfForward.reset(new ComplexFFT(half, false, backend));
+        impl.halfInverse.reset(new ComplexFFT(half, true, backend));
+        impl.twiddles.resize(half);
+        for (size_t k = 0; k < half; ++k)
+            impl.twiddles[k] = std::complex<float>(std::polar(1.0, -2.0 * M_PI * k / size));
+        impl.work.resize(half);
+    }
+    else {
+        impl.backend = FFTBackend::KissFFT;
+        impl.kissForward = kiss_fftr_alloc(size, false, nullptr, nullptr);
+        impl.kissInverse = kiss_fftr_alloc(size, true, nullptr, nullptr);
+        if (!impl.kissForward || !impl.kissInverse) {
+            kiss_fftr_free(impl.kissForward);
+            kiss_fftr_free(impl.kissInverse);
+            throw std::bad_alloc();
+        }
+    }
+}
+
+RealFFT::~RealFFT()
+{
+    kiss_fftr_free(_impl->kissForward);
+    kiss_fftr_free(_impl->kissInverse);
+}
+
+size_t RealFFT::size() const
+{
+    return _impl->size;
+}
+
+FFTBackend RealFFT::backend() const
+{
+    return _impl->backend;
+}
+
+void RealFFT::forward(const float* input, std::complex<float>* output)
+{
+    Impl& impl = *_impl;
+
+    if (!impl.halfForward) {
+        kiss_fftr(impl.kissForward, input, reinterpret_cast<kiss_fft_cpx*>(output));
+        return;
+    }
+
+    // transform the even and odd elements as the real and imaginary parts
+    const size_t half = impl.size / 2;
+    std::complex<float>* z = impl.work.data();
+    impl.halfForward->transform(reinterpret_cast<const std::complex<float>*>(input), z);
+
+    // the complex operations are expanded, avoiding the checks of infinity
+    const std::complex<float>* w = impl.twiddles.data();
+    for (size_t k = 0; k <= half; ++k) {
+        const std::complex<float> z1 = z[(k < half) ? k : 0];
+        const std::complex<float> z2 = z[(k > 0) ? (half - k) : 0];
+        // even = (z1 + conj(z2)) / 2, odd = -i * (z1 - conj(z2)) / 2
+        float evenRe = 0.5f * (z1.real() + z2.real());
+        float evenIm = 0.5f * (z1.imag() - z2.imag());
+        float oddRe = 0.5f * (z1.imag() + z2.imag());
+        float oddIm = -0.5f * (z1.real() - z2.real());
+        float wr = (k < half) ? w[k].real() : -1.0f;
+        float wi = (k < half) ? w[k].imag() : 0.0f;
+        output[k] = std::complex<float>(
+            evenRe + wr * oddRe - wi * oddIm,
+            evenIm + wr * oddIm + wi * oddRe);
+    }
+}
+
+void RealFFT::inverse(const std::complex<float>* input, float* output)
+{
+    Impl& impl = *_impl;
+
+    if (!impl.halfInverse) {
+        kiss_fftri(impl.kissInverse, reinterpret_cast<const kiss_fft_cpx*>(input), output);
+        return;
+    }
+
+    // recombine into the spectra of the even and odd elements
+    const size_t half = impl.size / 2;
+    std::complex<float>* z = impl.work.data();
+
+    const std::complex<float>* w = impl.twiddles.data();
+    for (size_t k = 0; k < half; ++k) {
+        const std::complex<float> x1 = input[k];
+        const std::complex<float> x2 = input[half - k];
+        // z = (x1 + conj(x2)) + i * conj(w) * (x1 - conj(x2))
+        float sumRe = x1.real() + x2.real();
+        float sumIm = x1.imag() - x2.imag();
+        float difRe = x1.real() - x2.real();
+        float difIm = x1.imag() + x2.imag();
+        float wr = w[k].real();
+        float wi = -w[k].imag();
+        float prodRe = wr * difRe - wi * difIm;
+        float prodIm = wr * difIm + wi * difRe;
+        z[k] = std::complex<float>(sumRe - prodIm, sumIm + prodRe);
+    }
+
+    impl.halfInverse->transform(z, reinterpret_cast<std::complex<float>*>(output));
+}
+
+//------------------------------------------------------------------------------
+/**
+ * @brief A cache of the plans of the most recently used sizes, which evicts
+ * the least recently used one when it is full. It keeps a single plan of the
+ * large sizes, whose memory is significant.
+ */
+template <class Plan>
+class PlanCache {
+public:
+    static constexpr size_t capacity = 8;
+    static constexpr size_t largeSize = 1 << 16;
+
+    template <class... Args>
+    Plan& get(size_t size, Args... args)
+    {
+        auto it = std::find_if(_entries.begin(), _entries.end(),
+            [size](const Entry& entry) { return entry.size == size; });
+
+        if (it == _entries.end()) {
+            if (size > largeSize) {
+                _entries.erase(std::remove_if(_entries.begin(), _entries.end(),
+                    [](const Entry& entry) { return entry.size > largeSize; }), _entries.end());
+            }
+            if (_entries.size() == capacity)
+                _entries.pop_back();
+            Entry entry;
+            entry.size = size;
+            entry.plan.reset(new Plan(size, args...));
+            _entries.insert(_entries.begin(), std::move(entry));
+        }
+        else
+            std::rotate(_entries.begin(), it, it + 1);
+
+        return *_entries.front().plan;
+    }
+
+private:
+    struct Entry {
+        size_t size = 0;
+        std::unique_ptr<Plan> plan;
+    };
+
+    // the most recently used first
+    std::vector<Entry> _entries;
+};
+
+ComplexFFT& getCachedComplexFFT(size_t size, bool inverse)
+{
+    static thread_local PlanCache<ComplexFFT> plans[2];
+    return plans[inverse].get(size, inverse);
+}
+
+RealFFT& getCachedRealFFT(size_t size)
+{
+    static thread_local PlanCache<RealFFT> plans;
+    return plans.get(size);
+}
+
+//------------------------------------------------------------------------------
+/**
+ * @brief Check whether a size is even and has no prime factors other than
+ * 2, 3 and 5, which the real FFT computes efficiently.
+ */
+static bool isSmoothSize(size_t n)
+{
+    if (n == 0 || (n & 1))
+        return false;
+    for (size_t p : { 2, 3, 5 }) {
+        while (n % p == 0)
+            n /= p;
+    }
+    return n == 1;
+}
+
+/**
+ * @brief Compute the first bins of the DFT of real data of any size, using
+ * Bluestein's algorithm, which is a convolution by a power-of-2 FFT.
+ */
+static void computeBluesteinDFT(nonstd::span<const float> input, nonstd::span<std::complex<float>> output)
+{
+    typedef std::complex<float> cpx;
+
+    const size_t size = input.size();
+    const size_t count = std::min(output.size(), size / 2 + 1);
+
+    size_t convSize = 1;
+    while (convSize < 2 * size - 1)
+        convSize <<= 1;
+
+    // the chirp w[j] = exp(-i*pi*j^2/N), with j^2 reduced modulo 2N for
+    // precision, since the chirp has this period
+    std::vector<std::complex<double>> chirp(size);
+    for (size_t j = 0; j < size; ++j) {
+        uint64_t r = static_cast<uint64_t>(j) * j % (2 * static_cast<uint64_t>(size));
+        chirp[j] = std::polar(1.0, -M_PI * static_cast<double>(r) / size);
+    }
+
+    std::vector<cpx> a(convSize);
+    std::vector<cpx> b(convSize);
+    for (size_t j = 0; j < size; ++j)
+        a[j] = cpx(static_cast<double>(input[j]) * chirp[j]);
+    b[0] = cpx(std::conj(chirp[0]));
+    for (size_t j = 1; j < size; ++j)
+        b[j] = b[convSize - j] = cpx(std::conj(chirp[j]));
+
+    ComplexFFT& forward = getCachedComplexFFT(convSize, false);
+    ComplexFFT& inverse = getCachedComplexFFT(convSize, true);
+
+    forward.transform(a.data(), a.data());
+    forward.transform(b.data(), b.data());
+    for (size_t i = 0; i < convSize; ++i)
+        a[i] *= b[i];
+    inverse.transform(a.data(), a.data());
+
+    for (size_t k = 0; k < count; ++k)
+        output[k] = cpx(chirp[k] * std::complex<double>(a[k]) * (1.0 / convSize));
+    std::fill(output.begin() + count, output.end(), cpx());
+}
+
+void computeRealDFT(nonstd::span<const float> input, nonstd::span<std::complex<float>> output)
+{
+    typedef std::complex<float> cpx;
+
+    const size_t size = input.size();
+
+    if (!isSmoothSize(size)) {
+        computeBluesteinDFT(input, output);
+        return;
+    }
+
+    const size_t specSize = size / 2 + 1;
+    std::vector<cpx> spec(specSize);
+
+    RealFFT& fft = getCachedRealFFT(size);
+    fft.forward(input.data(), spec.data());
+
+    const size_t count = std::min(output.size(), specSize);
+    std::copy(spec.begin(), spec.begin() + count, output.begin());
+    std::fill(output.begin() + count, output.end(), cpx());
+}
+
+} // namespace sfz
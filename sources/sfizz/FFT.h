@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include <nonstd/span.hpp>
+#include <memory>
+#include <complex>
+
+namespace sfz {
+
+/**
+   The implementations of the Fourier transform.
+ */
+enum class FFTBackend {
+    // kissfft, for any size
+    KissFFT,
+    // a radix-2 transform with SIMD, for sizes which are powers of 2;
+    // other sizes use kissfft.
+    Radix2,
+};
+
+// get the backend selected at build time
+FFTBackend defaultFFTBackend();
+
+// get the name of a backend
+const char* fftBackendName(FFTBackend backend);
+
+/**
+   A plan of the complex Fourier transform of a given size.
+
+   The transform is not normalized, the output of a forward and inverse
+   transform being the input multiplied by the size.
+   A plan must not be used by several threads at once.
+ */
+class ComplexFFT {
+public:
+    ComplexFFT(size_t size, bool inverse, FFTBackend backend = defaultFFTBackend());
+    ~ComplexFFT();
+
+    size_t size() const;
+
+    // get the backend which performs the transform, according to the size
+    FFTBackend backend() const;
+
+    // transform `size` elements; the input and output may be the same
+    void transform(const std::complex<float>* input, std::complex<float>* output);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+/**
+   A plan of the real Fourier transform of a given even size.
+
+   The spectrum of a real transform has `size / 2 + 1` bins.
+   The transform is not normalized, the output of a forward and inverse
+   transform being the input multiplied by the size.
+   A plan must not be used by several threads at once.
+ */
+class RealFFT {
+public:
+    explicit RealFFT(size_t size, FFTBackend backend = defaultFFTBackend());
+    ~RealFFT();
+
+    size_t size() const;
+
+    // get the backend which performs the transform, according to the size
+    FFTBackend backend() const;
+
+    // transform `size` real elements into `size / 2 + 1` bins
+    void forward(const float* input, std::complex<float>* output);
+
+    // transform `size / 2 + 1` bins into `size` real elements
+    void inverse(const std::complex<float>* input, float* output);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+/**
+   @brief Get a plan of the default backend, from a cache which belongs to the
+   calling thread. The cache keeps the plans of the few sizes used most
+   recently, so that repeated transforms of the same size do not allocate
+   again, while the memory stays bounded; a plan remains valid until the
+   thread has requested several other sizes of the same kind.
+ */
+ComplexFFT& getCachedComplexFFT(size_t size, bool inverse);
+RealFFT& getCachedRealFFT(size_t size);
+
+/**
+   @brief Compute the first bins of the discrete Fourier transform of real
+   data of any size, in O(N*log(N)) time.
+
+   Sizes which the real transform does not compute efficiently, the ones
+   which are odd or have prime factors above 5, use Bluestein's algorithm.
+   The bins above the Nyquist frequency of the input are set to zero.
+ */
+void computeRealDFT(nonstd::span<const float> input, nonstd::span<std::complex<float>> output);
+
+} // namespace sfz
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+
+namespace sfz {
+
+/**
+   An incremental 64-bit FNV-1a hash, to identify contents.
+ */
+class Hasher {
+public:
+    void update(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t h = _state;
+        for (size_t i = 0; i < size; ++i) {
+            h ^= bytes[i];
+            h *= 0x100000001b3u;
+        }
+        _state = h;
+    }
+
+    template <class T>
+    void update(const T& value)
+    {
+        static_assert(std::is_arithmetic<T>::value, "The value must be arithmetic");
+        update(&value, sizeof(T));
+    }
+
+    uint64_t digest() const { return _state; }
+
+private:
+    uint64_t _state = 0xcbf29ce484222325u;
+};
+
+/**
+   An incremental 64-bit hash which mixes words of 8 bytes by multiplications
+   and shifts. It shares nothing with `Hasher`, so a pair of both identifies
+   contents where a single hash of 64 bits may collide.
+ */
+class MixHasher {
+public:
+    void update(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            _word |= static_cast<uint64_t>(bytes[i]) << (8 * _fill);
+            if (++_fill == 8) {
+                _state = step(_state, _word);
+                _word = 0;
+                _fill = 0;
+            }
+        }
+        _size += size;
+    }
+
+    template <class T>
+    void update(const T& value)
+    {
+        static_assert(std::is_arithmetic<T>::value, "The value must be arithmetic");
+        update(&value, sizeof(T));
+    }
+
+    uint64_t digest() const
+    {
+        uint64_t h = _fill ? step(_state, _word) : _state;
+        return mix(h ^ _size);
+    }
+
+private:
+    // the finalizer of splitmix64
+    static uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9u;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebu;
+        x ^= x >> 31;
+        return x;
+    }
+
+    static uint64_t step(uint64_t h, uint64_t word)
+    {
+        h = (h << 31) | (h >> 33);
+        return (h ^ mix(word)) * 0x9e3779b97f4a7c15u;
+    }
+
+    uint64_t _state = 0x243f6a8885a308d3u;
+    uint64_t _word = 0;
+    unsigned _fill = 0;
+    uint64_t _size = 0;
+};
+
+} // namespace sfz
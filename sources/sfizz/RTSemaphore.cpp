@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "RTSemaphore.h"
+#include <system_error>
+#include <cerrno>
+#include <climits>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+namespace sfz {
+
+#if defined(_WIN32)
+struct RTSemaphore::Impl {
+    HANDLE sem;
+};
+
+RTSemaphore::RTSemaphore(unsigned value)
+    : _impl(new Impl)
+{
+    _impl->sem = CreateSemaphoreW(nullptr, static_cast<LONG>(value), LONG_MAX, nullptr);
+    if (!_impl->sem)
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category());
+}
+
+RTSemaphore::~RTSemaphore()
+{
+    CloseHandle(_impl->sem);
+}
+
+void RTSemaphore::post()
+{
+    ReleaseSemaphore(_impl->sem, 1, nullptr);
+}
+
+void RTSemaphore::wait()
+{
+    WaitForSingleObject(_impl->sem, INFINITE);
+}
+
+bool RTSemaphore::tryWait()
+{
+    return WaitForSingleObject(_impl->sem, 0) == WAIT_OBJECT_0;
+}
+
+#elif defined(__APPLE__)
+struct RTSemaphore::Impl {
+    dispatch_semaphore_t sem;
+};
+
+RTSemaphore::RTSemaphore(unsigned value)
+    : _impl(new Impl)
+{
+    _impl->sem = dispatch_semaphore_create(static_cast<long>(value));
+    if (!_impl->sem)
+        throw std::system_error(ENOMEM, std::generic_category());
+}
+
+RTSemaphore::~RTSemaphore()
+{
+    dispatch_release(_impl->sem);
+}
+
+void RTSemaphore::post()
+{
+    dispatch_semaphore_signal(_impl->sem);
+}
+
+void RTSemaphore::wait()
+{
+    dispatch_semaphore_wait(_impl->sem, DISPATCH_TIME_FOREVER);
+}
+
+bool RTSemaphore::tryWait()
+{
+    return dispatch_semaphore_wait(_impl->sem, DISPATCH_TIME_NOW) == 0;
+}
+
+#else
+struct RTSemaphore::Impl {
+    sem_t sem;
+};
+
+RTSemaphore::RTSemaphore(unsigned value)
+    : _impl(new Impl)
+{
+    if (sem_init(&_impl->sem, 0, value) != 0)
+        throw std::system_error(errno, std::generic_category());
+}
+
+RTSemaphore::~RTSemaphore()
+{
+    sem_destroy(&_impl->sem);
+}
+
+void RTSemaphore::post()
+{
+    sem_post(&_impl->sem);
+}
+
+void RTSemaphore::wait()
+{
+    while (sem_wait(&_impl->sem) != 0 && errno == EINTR)
+        ;
+}
+
+bool RTSemaphore::tryWait()
+{
+    int ret;
+    while ((ret = sem_trywait(&_impl->sem)) != 0 && errno == EINTR)
+        ;
+    return ret == 0;
+}
+#endif
+
+} // namespace sfz
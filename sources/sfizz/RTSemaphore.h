@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include <memory>
+
+namespace sfz {
+
+/**
+   A counting semaphore of the system, which a real-time thread can post
+   without taking a lock, to wake up a thread which waits.
+ */
+class RTSemaphore {
+public:
+    explicit RTSemaphore(unsigned value = 0);
+    ~RTSemaphore();
+
+    RTSemaphore(const RTSemaphore&) = delete;
+    RTSemaphore& operator=(const RTSemaphore&) = delete;
+
+    // increment the count, and wake up a waiting thread; real-time safe
+    void post();
+
+    // wait until the count is positive, and decrement it
+    void wait();
+
+    // decrement the count if it is positive, without waiting
+    bool tryWait();
+
+private:
+    // the semaphore of the system, apart so the header does not include
+    // the system headers
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+} // namespace sfz
@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "SpectralOscillator.h"
+#include <algorithm>
+#include <initializer_list>
+#include <cmath>
+
+namespace sfz {
+
+template <class T>
+constexpr unsigned TripleBuffer<T>::indexMask;
+template <class T>
+constexpr unsigned TripleBuffer<T>::dirtyBit;
+
+//------------------------------------------------------------------------------
+float SpectralModifiers::getGain(unsigned harmonic) const
+{
+    const float k = static_cast<float>(harmonic);
+
+    float gain = (harmonic & 1) ? oddGain : evenGain;
+    gain *= std::max(0.0f, std::min(1.0f, k - lowestHarmonic + 1.0f));
+    gain *= std::max(0.0f, std::min(1.0f, highestHarmonic + 1.0f - k));
+    if (gain == 0.0f)
+        return 0.0f;
+
+    if (tilt != 0.0f)
+        gain *= std::pow(10.0f, tilt * std::log2(k) * (1.0f / 20.0f));
+    return gain;
+}
+
+bool SpectralModifiers::operator==(const SpectralModifiers& other) const
+{
+    return tilt == other.tilt &&
+        lowestHarmonic == other.lowestHarmonic &&
+        highestHarmonic == other.highestHarmonic &&
+        oddGain == other.oddGain &&
+        evenGain == other.evenGain;
+}
+
+//------------------------------------------------------------------------------
+constexpr unsigned SpectralOscillator::levelsBelow;
+constexpr unsigned SpectralOscillator::levelsAbove;
+
+SpectralOscillator::~SpectralOscillator()
+{
+    stopWorker();
+}
+
+void SpectralOscillator::init(double sampleRate, unsigned tableSize, double refSampleRate)
+{
+    stopWorker();
+
+    _phasor.init(sampleRate);
+    _tableSize = tableSize;
+    _refSampleRate = refSampleRate;
+    _spectrum.assign(tableSize / 2 + 1, std::complex<float>());
+    _modifiedSpectrum.assign(tableSize / 2 + 1, std::complex<float>());
+
+    // silent tables until a profile is set
+    TabulatedHarmonicProfile silence(_spectrum);
+    for (unsigned i = 0; i < 3; ++i) {
+        TableFrame& frame = _tables.slot(i);
+        frame.wave = WavetableMulti::createForHarmonicProfile(silence, 0.0, tableSize, refSampleRate);
+        std::fill(std::begin(frame.versions), std::end(frame.versions), _requestedVersion);
+        frame.version = _requestedVersion;
+    }
+    _reader.setWavetable(&_tables.front().wave);
+
+    _running.store(true);
+    _worker = std::thread([this]() { runWorker(); });
+}
+
+void SpectralOscillator::clear()
+{
+    _phasor.clear();
+}
+
+void SpectralOscillator::setProfile(const HarmonicProfile& hp, double amplitude)
+{
+    // the worker holds the lock while it regenerates
+    std::lock_guard<std::mutex> lock(_workMutex);
+
+    _amplitude = amplitude;
+    for (size_t k = 0; k < _spectrum.size(); ++k)
+        _spectrum[k] = hp.getHarmonic(k);
+
+    modifySpectrum(_modifiers);
+    TabulatedHarmonicProfile modified(_modifiedSpectrum);
+    for (unsigned i = 0; i < 3; ++i) {
+        TableFrame& frame = _tables.slot(i);
+        frame.wave = WavetableMulti::createForHarmonicProfile(modified, amplitude, _tableSize, _refSampleRate);
+        std::fill(std::begin(frame.versions), std::end(frame.versions), _requestedVersion);
+        frame.version = _requestedVersion;
+    }
+    _reader.setWavetable(&_tables.front().wave);
+}
+
+void SpectralOscillator::setModifiers(const SpectralModifiers& modifiers)
+{
+    if (modifiers == _modifiers)
+        return;
+    _modifiers = modifiers;
+    ++_requestedVersion;
+}
+
+void SpectralOscillator::process(float frequency, float* output, unsigned nframes)
+{
+    // request the tables for these modifiers and this frequency, if they
+    // differ from the previous request
+    const unsigned index = static_cast<unsigned>(MipmapRange::getIndexForFrequency(frequency));
+    if (_postedVersion != _requestedVersion || _postedIndex != index) {
+        _postedVersion = _requestedVersion;
+        _postedIndex = index;
+        Request& request = _requests.back();
+        request.modifiers = _modifiers;
+        request.index = index;
+        request.version = _requestedVersion;
+        _requests.publish();
+        // the semaphore keeps the wake-up if the worker is not waiting yet
+        _wake.post();
+    }
+
+    if (_tables.acquire())
+        _reader.setWavetable(&_tables.front().wave);
+
+    constexpr unsigned bufferSize = 256;
+    float phases[bufferSize];
+
+    for (unsigned offset = 0; offset < nframes; offset += bufferSize) {
+        unsigned count = std::min(bufferSize, nframes - offset);
+        _phasor.process(frequency, phases, count);
+        _reader.process(frequency, phases, output + offset, count);
+    }
+}
+
+void SpectralOscillator::stopWorker()
+{
+    if (!_worker.joinable())
+        return;
+
+    _running.store(false);
+    _wake.post();
+    _worker.join();
+}
+
+void SpectralOscillator::runWorker()
+{
+    Request request;
+    // the frame published last, from which the back frame copies the tables
+    // which are up to date
+    const TableFrame* published = nullptr;
+
+    while (_running.load()) {
+        _wake.wait();
+
+        std::lock_guard<std::mutex> lock(_workMutex);
+        for (;;) {
+            if (_requests.acquire()) {
+                request = _requests.front();
+                modifySpectrum(request.modifiers);
+            }
+            TableFrame& frame = _tables.back();
+            if (refresh(frame, request, published)) {
+                published = &frame;
+                _tables.publish();
+            }
+            else if (!_requests.pending())
+                break;
+        }
+    }
+}
+
+void SpectralOscillator::modifySpectrum(const SpectralModifiers& modifiers)
+{
+    _modifiedSpectrum[0] = std::complex<float>();
+    for (size_t k = 1; k < _spectrum.size(); ++k) {
+        const std::complex<float> harmonic = _spectrum[k];
+        _modifiedSpectrum[k] = (harmonic != std::complex<float>()) ?
+            harmonic * modifiers.getGain(static_cast<unsigned>(k)) : harmonic;
+    }
+}
+
+bool SpectralOscillator::refresh(TableFrame& frame, const Request& request, const TableFrame* source)
+{
+    constexpr unsigned numTables = WavetableMulti::numTables();
+
+    // the tables around the requested range first, which get published as
+    // soon as they are regenerated
+    const unsigned first = (request.index > levelsBelow) ? (request.index - levelsBelow) : 0;
+    const unsigned last = std::min(request.index + levelsAbove, numTables - 1);
+
+    bool changed = false;
+    bool regenerated = false;
+    for (unsigned index = first; index <= last; ++index) {
+        if (frame.versions[index] < request.version) {
+            regenerated |= refreshTable(frame, index, request.version, source);
+            changed = true;
+        }
+    }
+
+    // then the others, the nearest first, unless another request comes; the
+    // index below wraps around past the first table, and gets skipped
+    if (!regenerated) {
+        for (unsigned distance = 1; distance < numTables; ++distance) {
+            const unsigned below = first - distance;
+            const unsigned above = last + distance;
+            for (unsigned index : { below, above }) {
+                if (index >= numTables || frame.versions[index] >= request.version)
+                    continue;
+                if (_requests.pending())
+                    return false;
+                refreshTable(frame, index, request.version, source);
+                changed = true;
+            }
+        }
+    }
+
+    frame.version = *std::min_element(std::begin(frame.versions), std::end(frame.versions));
+    return changed;
+}
+
+bool SpectralOscillator::refreshTable(TableFrame& frame, unsigned index, uint64_t version, const TableFrame* source)
+{
+    frame.versions[index] = version;
+
+    if (source && source->versions[index] == version) {
+        frame.wave.copyTable(index, source->wave);
+        return false;
+    }
+
+    TabulatedHarmonicProfile modified(_modifiedSpectrum);
+    frame.wave.regenerateTable(index, modified, _amplitude, _refSampleRate);
+    _tablesGenerated.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+} // namespace sfz
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include "Wavetables.h"
+#include "RTSemaphore.h"
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <complex>
+#include <cstdint>
+
+namespace sfz {
+
+/**
+   A wait-free exchange of values between one producer and one consumer
+   thread, with three slots: the producer writes in the back slot, the
+   consumer reads the front slot, and the middle slot holds the latest value
+   published and not yet acquired.
+ */
+template <class T>
+class TripleBuffer {
+public:
+    // get the slot which the producer writes
+    T& back() { return _slots[_back]; }
+
+    // publish the back slot, and take another one to write
+    void publish()
+    {
+        _back = _middle.exchange(_back | dirtyBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // take the latest slot published, if there is one since the last time
+    bool acquire()
+    {
+        if (!(_middle.load(std::memory_order_relaxed) & dirtyBit))
+            return false;
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    // whether a slot was published since the last time it was acquired
+    bool pending() const { return _middle.load(std::memory_order_relaxed) & dirtyBit; }
+
+    // get the slot which the consumer reads
+    const T& front() const { return _slots[_front]; }
+
+    // access any slot, when neither thread is running
+    T& slot(unsigned index) { return _slots[index]; }
+
+private:
+    static constexpr unsigned indexMask = 3;
+    static constexpr unsigned dirtyBit = 4;
+
+    T _slots[3] {};
+    unsigned _back = 0;
+    std::atomic<unsigned> _middle { 1 };
+    unsigned _front = 2;
+};
+
+/**
+   Modifications of a spectrum which get applied on the harmonics.
+ */
+struct SpectralModifiers {
+    // slope of the amplitudes, in dB per octave above the fundamental
+    float tilt = 0.0f;
+    // the harmonics which are kept; the edges are fractional, and the
+    // harmonic past each edge fades out according to the fractional part
+    float lowestHarmonic = 1.0f;
+    float highestHarmonic = 1e6f;
+    // the gains of the odd harmonics, the fundamental included, and the even
+    float oddGain = 1.0f;
+    float evenGain = 1.0f;
+
+    // get the gain of the harmonic of the given number, from 1
+    float getGain(unsigned harmonic) const;
+
+    bool operator==(const SpectralModifiers& other) const;
+    bool operator!=(const SpectralModifiers& other) const { return !operator==(other); }
+};
+
+/**
+   An oscillator which resynthesizes its tables from a spectrum which is
+   modified in real time.
+
+   The tables are regenerated by a worker thread, so the audio thread never
+   waits for an inverse FFT. With each block, the audio thread requests the
+   modifiers and the range of the mipmap which it plays, and wakes up the
+   worker by a semaphore. The worker regenerates the tables around that
+   range first, and publishes them by a triple buffer; then it brings the
+   other ranges to the same modifiers, the nearest first, and publishes the
+   complete mipmap. Each table keeps the version of its modifiers, so the
+   worker copies the tables which are up to date from the last frame it
+   published, instead of regenerating them.
+
+   Until they are published, the audio thread keeps playing the last tables;
+   after a jump of frequency, the new range may play older modifiers, until
+   the worker completes the mipmap.
+ */
+class SpectralOscillator {
+public:
+    SpectralOscillator() = default;
+    ~SpectralOscillator();
+
+    SpectralOscillator(const SpectralOscillator&) = delete;
+    SpectralOscillator& operator=(const SpectralOscillator&) = delete;
+
+    // initialize with the given sample rate, and start the worker thread;
+    // not real-time safe.
+    void init(double sampleRate, unsigned tableSize = 2048, double refSampleRate = 44100);
+
+    // reset the oscillator to the initial phase
+    void clear();
+
+    // set the spectrum to resynthesize, and generate all the tables;
+    // not real-time safe, nor safe while processing.
+    void setProfile(const HarmonicProfile& hp, double amplitude = 1.0);
+
+    // set the modifiers, which apply when the worker has regenerated the
+    // tables for them; called by the audio thread.
+    void setModifiers(const SpectralModifiers& modifiers);
+
+    // compute a block of output at a constant frequency
+    void process(float frequency, float* output, unsigned nframes);
+
+    // the version of the modifiers which were last set, and the oldest
+    // version of the modifiers among the tables which play; each change of
+    // the modifiers increments the version.
+    uint64_t requestedVersion() const { return _requestedVersion; }
+    uint64_t playingVersion() const { return _tables.front().version; }
+
+    // the number of tables which the worker regenerated, the copies aside
+    uint64_t tablesGenerated() const { return _tablesGenerated.load(std::memory_order_relaxed); }
+
+private:
+    // the number of tables regenerated around the requested range; one
+    // below for a decreasing frequency, two above for the interpolated pair
+    // and an increasing frequency.
+    static constexpr unsigned levelsBelow = 1;
+    static constexpr unsigned levelsAbove = 2;
+
+    struct Request {
+        SpectralModifiers modifiers;
+        unsigned index = 0;
+        uint64_t version = 0;
+    };
+
+    struct TableFrame {
+        WavetableMulti wave;
+        // the version of the modifiers of each table
+        uint64_t versions[MipmapRange::N] {};
+        // the oldest of the versions
+        uint64_t version = 0;
+    };
+
+    void stopWorker();
+    void runWorker();
+    // apply the modifiers on the spectrum
+    void modifySpectrum(const SpectralModifiers& modifiers);
+    // bring the tables of a frame to the version of a request, and get
+    // whether the frame is to be published; it stops early if another
+    // request comes.
+    bool refresh(TableFrame& frame, const Request& request, const TableFrame* source);
+    // bring a table to a version, by a copy from the source frame if it has
+    // the table up to date, and get whether it was regenerated
+    bool refreshTable(TableFrame& frame, unsigned index, uint64_t version, const TableFrame* source);
+
+    WavetablePhasor _phasor;
+    WavetableReader _reader;
+
+    double _amplitude = 1.0;
+    double _refSampleRate = 44100;
+    unsigned _tableSize = 0;
+    std::vector<std::complex<float>> _spectrum;
+    // owned by the worker
+    std::vector<std::complex<float>> _modifiedSpectrum;
+
+    // owned by the audio thread
+    SpectralModifiers _modifiers;
+    uint64_t _requestedVersion = 0;
+    // the last request sent to the worker
+    uint64_t _postedVersion = ~uint64_t(0);
+    unsigned _postedIndex = 0;
+
+    TripleBuffer<Request> _requests;
+    TripleBuffer<TableFrame> _tables;
+
+    std::thread _worker;
+    // held by the worker while it works
+    std::mutex _workMutex;
+    RTSemaphore _wake;
+    std::atomic<bool> _running { false };
+    std::atomic<uint64_t> _tablesGenerated { 0 };
+};
+
+} // namespace sfz
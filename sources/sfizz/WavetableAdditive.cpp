@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "WavetableAdditive.h"
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <functional>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SFZ_WAVETABLES_SSE2 1
+#endif
+
+namespace sfz {
+
+constexpr unsigned WavetableHybrid::maxHarmonics;
+constexpr unsigned WavetableHybrid::calibratedHarmonics;
+
+// the interval of frames at which the recurrences start again; the error
+// of a recurrence grows with the square of its length, and at 64 frames it
+// stays about 110 dB below the harmonics
+static constexpr unsigned restartInterval = 64;
+
+namespace {
+
+// the constants of the recurrences of the harmonics at a frequency
+struct HarmonicRecurrences {
+    unsigned numHarmonics = 0;
+    // the complex amplitude of each harmonic, at the phase 0
+    std::complex<double> weights[WavetableHybrid::maxHarmonics];
+    // the rotations of each harmonic by the frames -4 to 3 from a start
+    std::complex<double> rotations[WavetableHybrid::maxHarmonics][8];
+    // the coefficient 2 cos(4 w) of each harmonic
+    float coefs[WavetableHybrid::maxHarmonics];
+};
+
+} // namespace
+
+/**
+ * @brief Compute the constants of the recurrences of a sum of harmonics, in
+ * double precision, once for a block at a constant frequency.
+ */
+static void prepareHarmonics(
+    const float* amplitudes, const float* phases, const float* gains, unsigned numHarmonics,
+    float phaseInc, HarmonicRecurrences& rec)
+{
+    rec.numHarmonics = numHarmonics;
+    for (unsigned k = 1; k <= numHarmonics; ++k) {
+        const double w = 2 * M_PI * k * phaseInc;
+        const std::complex<double> step = std::polar(1.0, w);
+        rec.weights[k - 1] = std::polar(static_cast<double>(gains[k - 1] * amplitudes[k - 1]),
+            static_cast<double>(phases[k - 1]));
+        std::complex<double> rotation = std::polar(1.0, -4 * w);
+        for (unsigned i = 0; i < 8; ++i, rotation *= step)
+            rec.rotations[k - 1][i] = rotation;
+        rec.coefs[k - 1] = static_cast<float>(2 * std::cos(4 * w));
+    }
+}
+
+/**
+ * @brief Synthesize a sum of harmonics, each of them by the recurrence
+ * y[n+4] = 2 cos(4 w) y[n] - y[n-4], which computes four frames at once.
+ * The recurrences start again at each call, from the given phase in cycles,
+ * with initial frames in double precision.
+ */
+static void synthesizeHarmonics(
+    const HarmonicRecurrences& rec, double phase, float* output, unsigned nframes)
+{
+    constexpr unsigned maxHarmonics = WavetableHybrid::maxHarmonics;
+    alignas(16) float current[maxHarmonics][4];
+    alignas(16) float previous[maxHarmonics][4];
+    const unsigned numHarmonics = rec.numHarmonics;
+    const float* coefs = rec.coefs;
+
+    // the initial frames, from the rotation of the start by each harmonic
+    const std::complex<double> start = std::polar(1.0, 2 * M_PI * phase);
+    std::complex<double> startK = 1.0;
+    for (unsigned k = 0; k < numHarmonics; ++k) {
+        startK *= start;
+        const std::complex<double> z = rec.weights[k] * startK;
+        const std::complex<double>* rotations = rec.rotations[k];
+        for (unsigned i = 0; i < 4; ++i)
+            previous[k][i] = static_cast<float>(z.real() * rotations[i].real() - z.imag() * rotations[i].imag());
+        for (unsigned i = 0; i < 4; ++i)
+            current[k][i] = static_cast<float>(z.real() * rotations[4 + i].real() - z.imag() * rotations[4 + i].imag());
+    }
+
+    unsigned offset = 0;
+    float tail[4];
+
+    while (offset < nframes) {
+        float* dst = (nframes - offset >= 4) ? (output + offset) : tail;
+#if SFZ_WAVETABLES_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (unsigned k = 0; k < numHarmonics; ++k) {
+            __m128 y0 = _mm_load_ps(current[k]);
+            __m128 ym = _mm_load_ps(previous[k]);
+            sum = _mm_add_ps(sum, y0);
+            _mm_store_ps(previous[k], y0);
+            _mm_store_ps(current[k], _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(coefs[k]), y0), ym));
+        }
+        _mm_storeu_ps(dst, sum);
+#else
+        float sum[4] {};
+        for (unsigned k = 0; k < numHarmonics; ++k) {
+            for (unsigned i = 0; i < 4; ++i) {
+                float y0 = current[k][i];
+                float ym = previous[k][i];
+                sum[i] += y0;
+                previous[k][i] = y0;
+                current[k][i] = coefs[k] * y0 - ym;
+            }
+        }
+        std::copy(sum, sum + 4, dst);
+#endif
+        if (dst == tail)
+            std::copy(tail, tail + (nframes - offset), output + offset);
+        offset += 4;
+    }
+}
+
+//------------------------------------------------------------------------------
+WavetableHybrid WavetableHybrid::createForHarmonicProfile(
+    const HarmonicProfile& hp, double amplitude, unsigned tableSize,
+    double refSampleRate, unsigned additiveHarmonics)
+{
+    WavetableHybrid wh;
+    constexpr unsigned numTables = WavetableMulti::numTables();
+
+    if (additiveHarmonics == calibratedHarmonics) {
+        static const unsigned calibrated = calibrateAdditiveHarmonics();
+        additiveHarmonics = calibrated;
+    }
+    additiveHarmonics = std::min(additiveHarmonics, maxHarmonics);
+
+    for (unsigned m = 0; m < numTables; ++m) {
+        wh._harmonicCounts[m] = getHarmonicCount(m, tableSize, refSampleRate);
+        if (wh._firstAdditiveIndex == numTables && wh._harmonicCounts[m] <= additiveHarmonics)
+            wh._firstAdditiveIndex = m;
+    }
+
+    // the first additive range keeps its table, which the range below it
+    // reads as the upper table of its pair
+    wh._tables = WavetableMulti::createForHarmonicProfile(hp, amplitude, tableSize, refSampleRate);
+    wh._tables.releaseTables(wh._firstAdditiveIndex + 1);
+
+    // the harmonics which the tables generate are `amplitude * Re(i * H[k])`
+    // at the phase 0, as a sum of cosines
+    const unsigned numHarmonics = (wh._firstAdditiveIndex < numTables) ?
+        wh._harmonicCounts[wh._firstAdditiveIndex] : 0;
+    wh._amplitudes.resize(numHarmonics);
+    wh._phases.resize(numHarmonics);
+    for (unsigned k = 1; k <= numHarmonics; ++k) {
+        std::complex<double> harmonic = hp.getHarmonic(k);
+        wh._amplitudes[k - 1] = static_cast<float>(amplitude * std::abs(harmonic));
+        wh._phases[k - 1] = static_cast<float>(std::arg(harmonic) + M_PI / 2);
+    }
+
+    return wh;
+}
+
+unsigned WavetableHybrid::getHarmonicCount(unsigned index, unsigned tableSize, double refSampleRate)
+{
+    // the same cutoff as the generation of the tables
+    double freq = MipmapRange::getRangeForIndex(index).maxFrequency;
+    double cutoff = (0.5 * refSampleRate / tableSize) / freq;
+
+    unsigned count = 0;
+    while (count + 1 < tableSize / 2 + 1 && (count + 1) * (1.0 / tableSize) <= cutoff)
+        ++count;
+    return count;
+}
+
+namespace {
+
+// a sawtooth, to measure the tables
+class CalibrationProfile : public HarmonicProfile {
+public:
+    std::complex<double> getHarmonic(size_t index) const override
+    {
+        return (index == 0) ? 0.0 : (1.0 / index);
+    }
+};
+
+} // namespace
+
+unsigned WavetableHybrid::calibrateAdditiveHarmonics(unsigned tableSize)
+{
+    typedef std::chrono::steady_clock clock;
+    constexpr double sampleRate = 48000.0;
+    constexpr unsigned blockSize = 256;
+    constexpr unsigned numBlocks = 32;
+    constexpr unsigned numRuns = 3;
+
+    const WavetableMulti multi = WavetableMulti::createForHarmonicProfile(
+        CalibrationProfile(), 1.0, tableSize, sampleRate);
+    WavetableOscillator osc;
+    osc.init(sampleRate);
+    osc.setWavetable(&multi);
+
+    float output[blockSize];
+    float ones[maxHarmonics];
+    std::fill(ones, ones + maxHarmonics, 1.0f);
+    float sink = 0.0f;
+
+    // the fastest of a few runs of a block function
+    auto measure = [&](const std::function<void()>& block) -> double {
+        double best = 0.0;
+        for (unsigned run = 0; run < numRuns; ++run) {
+            clock::time_point start = clock::now();
+            for (unsigned b = 0; b < numBlocks; ++b) {
+                block();
+                sink += output[b % blockSize];
+            }
+            std::chrono::duration<double> duration = clock::now() - start;
+            best = (run == 0) ? duration.count() : std::min(best, duration.count());
+        }
+        return best;
+    };
+
+    // go down from the highest range, while the synthesis is faster
+    unsigned additiveHarmonics = 0;
+    for (unsigned m = WavetableMulti::numTables(); m-- > 0;) {
+        const unsigned numHarmonics = getHarmonicCount(m, tableSize, sampleRate);
+        if (numHarmonics > maxHarmonics)
+            break;
+
+        const MipmapRange range = MipmapRange::getRangeForIndex(m);
+        const float frequency = std::sqrt(range.minFrequency * range.maxFrequency);
+        const float phaseInc = static_cast<float>(frequency / sampleRate);
+
+        double tableTime = measure([&]() {
+            osc.process(frequency, output, blockSize);
+        });
+        double additiveTime = measure([&]() {
+            HarmonicRecurrences rec;
+            prepareHarmonics(ones, ones, ones, numHarmonics, phaseInc, rec);
+            for (unsigned offset = 0; offset < blockSize; offset += restartInterval)
+                synthesizeHarmonics(rec, 0.0, output + offset, restartInterval);
+        });
+        if (additiveTime > tableTime)
+            break;
+
+        additiveHarmonics = numHarmonics;
+    }
+
+    // keep the measured outputs from being optimized out
+    volatile float keep = sink;
+    (void)keep;
+
+    return additiveHarmonics;
+}
+
+size_t WavetableHybrid::tableMemory() const
+{
+    return static_cast<size_t>(_tables.storedTables()) * _tables.tableStride() * sizeof(float);
+}
+
+//------------------------------------------------------------------------------
+void WavetableHybridOscillator::init(double sampleRate)
+{
+    _phasor.init(sampleRate);
+    _sampleInterval = static_cast<float>(1.0 / sampleRate);
+}
+
+void WavetableHybridOscillator::clear()
+{
+    _phasor.clear();
+}
+
+void WavetableHybridOscillator::setWavetable(const WavetableHybrid* wave)
+{
+    _wave = wave;
+    _reader.setWavetable(wave ? &wave->tables() : nullptr);
+}
+
+void WavetableHybridOscillator::process(float frequency, float* output, unsigned nframes)
+{
+    const WavetableHybrid* wave = _wave;
+    if (!wave) {
+        std::fill(output, output + nframes, 0.0f);
+        return;
+    }
+
+    const float index = MipmapRange::getIndexForFrequency(frequency);
+    const unsigned lower = static_cast<unsigned>(index);
+
+    if (lower < wave->firstAdditiveIndex()) {
+        constexpr unsigned bufferSize = 256;
+        float phases[bufferSize];
+
+        for (unsigned offset = 0; offset < nframes; offset += bufferSize) {
+            unsigned count = std::min(bufferSize, nframes - offset);
+            _phasor.process(frequency, phases, count);
+            _reader.process(frequency, phases, output + offset, count);
+        }
+        return;
+    }
+
+    // the gains of the harmonics, blended between the pair of ranges like
+    // the tables
+    const unsigned upper = std::min(lower + 1, WavetableMulti::numTables() - 1);
+    const float blend = index - lower;
+    const unsigned numHarmonics = wave->harmonicCount(lower);
+    const unsigned upperHarmonics = wave->harmonicCount(upper);
+
+    float gains[WavetableHybrid::maxHarmonics];
+    float amplitudes[WavetableHybrid::maxHarmonics];
+    float harmonicPhases[WavetableHybrid::maxHarmonics];
+    for (unsigned k = 1; k <= numHarmonics; ++k) {
+        gains[k - 1] = (k <= upperHarmonics) ? 1.0f : (1.0f - blend);
+        amplitudes[k - 1] = wave->harmonicAmplitude(k);
+        harmonicPhases[k - 1] = wave->harmonicPhase(k);
+    }
+
+    // the recurrences need the phase at their start only; they start again
+    // at regular intervals, which bounds their accumulated error
+    const float phaseInc = frequency * _sampleInterval;
+    const double startPhase = _phasor.phase();
+
+    auto phaseAt = [startPhase, phaseInc](unsigned frame) -> double {
+        double phase = startPhase + static_cast<double>(phaseInc) * frame;
+        return phase - std::floor(phase);
+    };
+
+    HarmonicRecurrences rec;
+    prepareHarmonics(amplitudes, harmonicPhases, gains, numHarmonics, phaseInc, rec);
+    for (unsigned offset = 0; offset < nframes; offset += restartInterval) {
+        unsigned count = std::min(restartInterval, nframes - offset);
+        synthesizeHarmonics(rec, phaseAt(offset), output + offset, count);
+    }
+
+    const float endPhase = static_cast<float>(phaseAt(nframes));
+    _phasor.setPhase((endPhase < 1.0f) ? endPhase : 0.0f);
+}
+
+} // namespace sfz
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include "Wavetables.h"
+#include <vector>
+
+namespace sfz {
+
+/**
+   A multisample whose highest ranges, which keep few harmonics, are
+   synthesized additively from the spectrum instead of read from tables.
+
+   The tables of these ranges are released, except the first one, which the
+   range below it reads as the upper table of its pair.
+ */
+class WavetableHybrid {
+public:
+    // maximum number of harmonics of a range which is synthesized
+    static constexpr unsigned maxHarmonics = 16;
+
+    // the number of harmonics measured by `calibrateAdditiveHarmonics`,
+    // once for the process
+    static constexpr unsigned calibratedHarmonics = ~0u;
+
+    // create a multisample according to a harmonic profile, which
+    // synthesizes the ranges of at most the given number of harmonics
+    static WavetableHybrid createForHarmonicProfile(
+        const HarmonicProfile& hp, double amplitude,
+        unsigned tableSize = 2048, double refSampleRate = 44100,
+        unsigned additiveHarmonics = calibratedHarmonics);
+
+    // get the number of harmonics which the N-th table keeps
+    static unsigned getHarmonicCount(unsigned index, unsigned tableSize, double refSampleRate);
+
+    // measure the largest number of harmonics which are synthesized faster
+    // than read from tables of the given size, from 0 to `maxHarmonics`;
+    // it takes a few milliseconds.
+    static unsigned calibrateAdditiveHarmonics(unsigned tableSize = 2048);
+
+    // get the index of the first range which is synthesized, or the number
+    // of tables if there is none
+    unsigned firstAdditiveIndex() const { return _firstAdditiveIndex; }
+
+    // get the number of harmonics of the N-th range
+    unsigned harmonicCount(unsigned index) const { return _harmonicCounts[index]; }
+
+    // get the amplitude and the phase of the N-th harmonic, from 1, of the
+    // ranges which are synthesized; the waveform is a sum of
+    // `amplitude * cos(2 * pi * k * phase + phase offset)`
+    float harmonicAmplitude(unsigned k) const { return _amplitudes[k - 1]; }
+    float harmonicPhase(unsigned k) const { return _phases[k - 1]; }
+
+    // get the memory of the stored tables, in bytes
+    size_t tableMemory() const;
+
+private:
+    // the tables are stored up to the first range which is synthesized, so
+    // only the hybrid oscillator, which never reads past it, may play them
+    friend class WavetableHybridOscillator;
+    const WavetableMulti& tables() const { return _tables; }
+
+    WavetableMulti _tables;
+    unsigned _firstAdditiveIndex = MipmapRange::N;
+    unsigned _harmonicCounts[MipmapRange::N] {};
+    std::vector<float> _amplitudes;
+    std::vector<float> _phases;
+};
+
+/**
+   An oscillator which plays a hybrid multisample: it reads the tables in
+   the lower ranges, and it synthesizes the highest ranges by sine
+   recurrences, four frames at once, from the harmonics of the multisample.
+ */
+class WavetableHybridOscillator {
+public:
+    // initialize with the given sample rate
+    void init(double sampleRate);
+
+    // reset the oscillator to the initial phase
+    void clear();
+
+    // set the multisample to play; it must outlive the oscillator
+    void setWavetable(const WavetableHybrid* wave);
+
+    // compute a block of output at a constant frequency
+    void process(float frequency, float* output, unsigned nframes);
+
+private:
+    WavetablePhasor _phasor;
+    WavetableReader _reader;
+    const WavetableHybrid* _wave = nullptr;
+    float _sampleInterval = 0.0f;
+};
+
+} // namespace sfz
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "WavetableHandle.h"
+
+namespace sfz {
+
+WavetableHandle::~WavetableHandle()
+{
+    delete _current.load();
+}
+
+const WavetableMulti* WavetableHandle::beginBlock(unsigned reader)
+{
+    _reclaimer.enter(reader);
+    return _current.load();
+}
+
+void WavetableHandle::publish(std::unique_ptr<const WavetableMulti> wave)
+{
+    const WavetableMulti* previous = _current.exchange(wave.release());
+    _publishCount.fetch_add(1, std::memory_order_relaxed);
+    if (previous)
+        _reclaimer.retire(previous);
+    _reclaimer.reclaim();
+}
+
+} // namespace sfz
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include "Wavetables.h"
+#include "EpochReclaimer.h"
+#include <memory>
+#include <atomic>
+
+namespace sfz {
+
+/**
+   A handle on a multisample which an editor replaces while voices play it.
+
+   The editor publishes a new multisample by swapping an atomic pointer, and
+   the previous one gets deleted by the editor once no audio thread can read
+   it any more. An audio thread gets the multisample of a block in
+   `beginBlock`, and it plays it until `endBlock`; the voices pick up the
+   new multisample at the next block, without locking.
+ */
+class WavetableHandle {
+public:
+    WavetableHandle() = default;
+    // delete the multisamples; no reader may be inside a block
+    ~WavetableHandle();
+
+    WavetableHandle(const WavetableHandle&) = delete;
+    WavetableHandle& operator=(const WavetableHandle&) = delete;
+
+    // register an audio thread, and get its number, or -1 if there are too
+    // many; not real-time safe.
+    int addReader() { return _reclaimer.addReader(); }
+
+    // unregister an audio thread, outside of a block
+    void removeReader(unsigned reader) { _reclaimer.removeReader(reader); }
+
+    // get the multisample to play for a block, or null if none was
+    // published; it remains valid until the end of the block. wait-free.
+    const WavetableMulti* beginBlock(unsigned reader);
+
+    // end the block of an audio thread; wait-free
+    void endBlock(unsigned reader) { _reclaimer.leave(reader); }
+
+    // replace the multisample, and delete the previous ones which no audio
+    // thread plays; not real-time safe.
+    void publish(std::unique_ptr<const WavetableMulti> wave);
+
+    // delete the replaced multisamples which no audio thread plays any
+    // more, and get the number of those which remain; not real-time safe.
+    size_t reclaim() { return _reclaimer.reclaim(); }
+
+    // the number of multisamples published
+    uint64_t publishCount() const { return _publishCount.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<const WavetableMulti*> _current { nullptr };
+    std::atomic<uint64_t> _publishCount { 0 };
+    EpochReclaimer _reclaimer;
+};
+
+} // namespace sfz
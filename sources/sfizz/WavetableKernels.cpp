@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "WavetableKernels.h"
+#include <algorithm>
+#if defined(SFZ_HAVE_SSE2_KERNELS)
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace sfz {
+
+void mixVoicesScalar(const VoiceLanes& lanes, unsigned tableSize, float* output, unsigned nframes)
+{
+    std::fill(output, output + nframes, 0.0f);
+
+    for (unsigned v = 0; v < lanes.count; ++v) {
+        const float gain = lanes.gain[v];
+        if (gain == 0.0f)
+            continue;
+
+        const float* lower = lanes.tables + lanes.lower[v];
+        const float* upper = lanes.tables + lanes.upper[v];
+        const float blend = lanes.blend[v];
+        const float increment = lanes.increment[v];
+        float phase = lanes.phase[v];
+
+        for (unsigned i = 0; i < nframes; ++i) {
+            float pos = phase * tableSize;
+            unsigned j = static_cast<unsigned>(pos);
+            float mu = pos - j;
+            float a = lower[j] + mu * (lower[j + 1] - lower[j]);
+            float b = upper[j] + mu * (upper[j + 1] - upper[j]);
+            output[i] += gain * (a + blend * (b - a));
+
+            phase += increment;
+            phase -= static_cast<int>(phase);
+            phase += (phase < 0.0f) ? 1.0f : 0.0f;
+        }
+
+        lanes.phase[v] = phase;
+    }
+}
+
+#if defined(SFZ_HAVE_SSE2_KERNELS)
+void mixVoicesSSE2(const VoiceLanes& lanes, unsigned tableSize, float* output, unsigned nframes)
+{
+    // the voices accumulate in the lanes of a buffer, which gets summed once
+    // per block, instead of once per group of voices
+    constexpr unsigned blockSize = 256;
+    alignas(16) float acc[4 * blockSize];
+
+    const float* tables = lanes.tables;
+    const __m128 size = _mm_set1_ps(static_cast<float>(tableSize));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (unsigned offset = 0; offset < nframes; offset += blockSize) {
+        const unsigned count = std::min(blockSize, nframes - offset);
+        std::fill(acc, acc + 4 * count, 0.0f);
+
+        for (unsigned v = 0; v < lanes.count; v += 4) {
+            const __m128 gain = _mm_load_ps(&lanes.gain[v]);
+            const __m128 audible = _mm_cmpneq_ps(gain, zero);
+            if (_mm_movemask_ps(audible) == 0)
+                continue;
+
+            const int32_t* lower = &lanes.lower[v];
+            const int32_t* upper = &lanes.upper[v];
+            const __m128 blend = _mm_load_ps(&lanes.blend[v]);
+            const __m128 increment = _mm_load_ps(&lanes.increment[v]);
+            const __m128 initialPhase = _mm_load_ps(&lanes.phase[v]);
+            __m128 phase = initialPhase;
+
+            for (unsigned i = 0; i < count; ++i) {
+                __m128 pos = _mm_mul_ps(phase, size);
+                __m128i ipos = _mm_cvttps_epi32(pos);
+                __m128 mu = _mm_sub_ps(pos, _mm_cvtepi32_ps(ipos));
+
+                alignas(16) int32_t j[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(j), ipos);
+
+                const float* l0 = tables + lower[0] + j[0];
+                const float* l1 = tables + lower[1] + j[1];
+                const float* l2 = tables + lower[2] + j[2];
+                const float* l3 = tables + lower[3] + j[3];
+                const float* u0 = tables + upper[0] + j[0];
+                const float* u1 = tables + upper[1] + j[1];
+                const float* u2 = tables + upper[2] + j[2];
+                const float* u3 = tables + upper[3] + j[3];
+                __m128 a1 = _mm_setr_ps(l0[0], l1[0], l2[0], l3[0]);
+                __m128 a2 = _mm_setr_ps(l0[1], l1[1], l2[1], l3[1]);
+                __m128 b1 = _mm_setr_ps(u0[0], u1[0], u2[0], u3[0]);
+                __m128 b2 = _mm_setr_ps(u0[1], u1[1], u2[1], u3[1]);
+
+                __m128 a = _mm_add_ps(a1, _mm_mul_ps(mu, _mm_sub_ps(a2, a1)));
+                __m128 b = _mm_add_ps(b1, _mm_mul_ps(mu, _mm_sub_ps(b2, b1)));
+                __m128 y = _mm_add_ps(a, _mm_mul_ps(blend, _mm_sub_ps(b, a)));
+                _mm_store_ps(&acc[4 * i], _mm_add_ps(_mm_load_ps(&acc[4 * i]), _mm_mul_ps(gain, y)));
+
+                phase = _mm_add_ps(phase, increment);
+                phase = _mm_sub_ps(phase, _mm_cvtepi32_ps(_mm_cvttps_epi32(phase)));
+                phase = _mm_add_ps(phase, _mm_and_ps(_mm_cmplt_ps(phase, zero), one));
+            }
+
+            // like the scalar kernel, the voices without gain keep their phase
+            phase = _mm_or_ps(_mm_and_ps(audible, phase), _mm_andnot_ps(audible, initialPhase));
+            _mm_store_ps(&lanes.phase[v], phase);
+        }
+
+        // sum the lanes of 4 frames at once, by transposition
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 y0 = _mm_load_ps(&acc[4 * i]);
+            __m128 y1 = _mm_load_ps(&acc[4 * i + 4]);
+            __m128 y2 = _mm_load_ps(&acc[4 * i + 8]);
+            __m128 y3 = _mm_load_ps(&acc[4 * i + 12]);
+            _MM_TRANSPOSE4_PS(y0, y1, y2, y3);
+            _mm_storeu_ps(&output[offset + i], _mm_add_ps(_mm_add_ps(y0, y1), _mm_add_ps(y2, y3)));
+        }
+        for (; i < count; ++i) {
+            const float* y = &acc[4 * i];
+            output[offset + i] = (y[0] + y[1]) + (y[2] + y[3]);
+        }
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+#if defined(SFZ_HAVE_AVX2_KERNELS)
+static bool detectAVX2()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    // the OS must save the registers of AVX
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+static bool cpuSupportsAVX2()
+{
+    static const bool supported = detectAVX2();
+    return supported;
+}
+#endif
+
+bool isVoiceKernelSupported(VoiceKernel kernel)
+{
+    switch (kernel) {
+    case VoiceKernel::Scalar:
+        return true;
+    case VoiceKernel::SSE2:
+#if defined(SFZ_HAVE_SSE2_KERNELS)
+        return true;
+#else
+        return false;
+#endif
+    case VoiceKernel::AVX2:
+#if defined(SFZ_HAVE_AVX2_KERNELS)
+        return cpuSupportsAVX2();
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+VoiceKernel bestVoiceKernel()
+{
+    if (isVoiceKernelSupported(VoiceKernel::AVX2))
+        return VoiceKernel::AVX2;
+    if (isVoiceKernelSupported(VoiceKernel::SSE2))
+        return VoiceKernel::SSE2;
+    return VoiceKernel::Scalar;
+}
+
+const char* voiceKernelName(VoiceKernel kernel)
+{
+    switch (kernel) {
+    case VoiceKernel::Scalar:
+        return "scalar";
+    case VoiceKernel::SSE2:
+        return "sse2";
+    case VoiceKernel::AVX2:
+        return "avx2";
+    }
+    return "";
+}
+
+MixVoicesFunction getMixVoicesFunction(VoiceKernel kernel)
+{
+    switch (kernel) {
+    case VoiceKernel::Scalar:
+        break;
+    case VoiceKernel::SSE2:
+#if defined(SFZ_HAVE_SSE2_KERNELS)
+        return &mixVoicesSSE2;
+#else
+        break;
+#endif
+    case VoiceKernel::AVX2:
+#if defined(SFZ_HAVE_AVX2_KERNELS)
+        return &mixVoicesAVX2;
+#else
+        break;
+#endif
+    }
+    return &mixVoicesScalar;
+}
+
+} // namespace sfz
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SFZ_HAVE_SSE2_KERNELS 1
+#endif
+
+// the AVX2 kernel is in a file of its own, built with AVX2 instructions, and
+// SFZ_HAVE_AVX2_KERNELS is defined by the build if the compiler supports it.
+
+namespace sfz {
+
+/**
+   The voices which read a multisample, as arrays of lanes. The number of
+   lanes is a multiple of `voiceLaneAlignment`; the arrays are aligned on
+   32 bytes, and the unused lanes have no gain.
+ */
+struct VoiceLanes {
+    // the first table of the multisample, from which the offsets count
+    const float* tables = nullptr;
+    // offsets of the tables to crossfade for each voice
+    const int32_t* lower = nullptr;
+    const int32_t* upper = nullptr;
+    const float* blend = nullptr;
+    // phase of each voice, which the kernel advances, except for the voices
+    // with no gain, whose phase holds still in every kernel
+    float* phase = nullptr;
+    const float* increment = nullptr;
+    const float* gain = nullptr;
+    unsigned count = 0;
+};
+
+// the number of lanes is a multiple of this number, the size of the widest vector
+static constexpr unsigned voiceLaneAlignment = 8;
+
+/**
+   The implementations of the kernel which mixes the voices.
+ */
+enum class VoiceKernel {
+    Scalar,
+    SSE2,
+    // 8 voices per vector, with gathers
+    AVX2,
+};
+
+// a kernel which mixes a block of the voices into the output
+typedef void (*MixVoicesFunction)(const VoiceLanes& lanes, unsigned tableSize, float* output, unsigned nframes);
+
+void mixVoicesScalar(const VoiceLanes& lanes, unsigned tableSize, float* output, unsigned nframes);
+#if defined(SFZ_HAVE_SSE2_KERNELS)
+void mixVoicesSSE2(const VoiceLanes& lanes, unsigned tableSize, float* output, unsigned nframes);
+#endif
+#if defined(SFZ_HAVE_AVX2_KERNELS)
+void mixVoicesAVX2(const VoiceLanes& lanes, unsigned tableSize, float* output, unsigned nframes);
+#endif
+
+// whether the kernel is built, and the processor supports it
+bool isVoiceKernelSupported(VoiceKernel kernel);
+
+// get the fastest kernel which the processor supports
+VoiceKernel bestVoiceKernel();
+
+// get the name of a kernel
+const char* voiceKernelName(VoiceKernel kernel);
+
+// get the function of a kernel, which must be supported
+MixVoicesFunction getMixVoicesFunction(VoiceKernel kernel);
+
+} // namespace sfz
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+// This file is built with AVX2 instructions, and its functions must be called
+// only if the processor supports them. It must not instantiate any template
+// or inline function of the library, such as std::min: their copies built
+// with AVX2 may be the ones which the linker keeps for the whole program.
+
+#include "WavetableKernels.h"
+#if defined(SFZ_HAVE_AVX2_KERNELS)
+#include <immintrin.h>
+
+namespace sfz {
+
+void mixVoicesAVX2(const VoiceLanes& lanes, unsigned tableSize, float* output, unsigned nframes)
+{
+    // the voices accumulate in the lanes of a buffer, which gets summed once
+    // per block, instead of once per group of voices
+    constexpr unsigned blockSize = 256;
+    alignas(32) float acc[8 * blockSize];
+
+    const float* tables = lanes.tables;
+    const __m256 size = _mm256_set1_ps(static_cast<float>(tableSize));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i next = _mm256_set1_epi32(1);
+
+    for (unsigned offset = 0; offset < nframes; offset += blockSize) {
+        const unsigned count = (nframes - offset < blockSize) ? (nframes - offset) : blockSize;
+        for (unsigned i = 0; i < count; ++i)
+            _mm256_store_ps(&acc[8 * i], zero);
+
+        for (unsigned v = 0; v < lanes.count; v += 8) {
+            const __m256 gain = _mm256_load_ps(&lanes.gain[v]);
+            const __m256 audible = _mm256_cmp_ps(gain, zero, _CMP_NEQ_OQ);
+            if (_mm256_movemask_ps(audible) == 0)
+                continue;
+
+            const __m256i lower = _mm256_load_si256(reinterpret_cast<const __m256i*>(&lanes.lower[v]));
+            const __m256i upper = _mm256_load_si256(reinterpret_cast<const __m256i*>(&lanes.upper[v]));
+            const __m256 blend = _mm256_load_ps(&lanes.blend[v]);
+            const __m256 increment = _mm256_load_ps(&lanes.increment[v]);
+            const __m256 initialPhase = _mm256_load_ps(&lanes.phase[v]);
+            __m256 phase = initialPhase;
+
+            for (unsigned i = 0; i < count; ++i) {
+                __m256 pos = _mm256_mul_ps(phase, size);
+                __m256i ipos = _mm256_cvttps_epi32(pos);
+                __m256 mu = _mm256_sub_ps(pos, _mm256_cvtepi32_ps(ipos));
+
+                __m256i l = _mm256_add_epi32(lower, ipos);
+                __m256i u = _mm256_add_epi32(upper, ipos);
+                __m256 a1 = _mm256_i32gather_ps(tables, l, 4);
+                __m256 a2 = _mm256_i32gather_ps(tables, _mm256_add_epi32(l, next), 4);
+                __m256 b1 = _mm256_i32gather_ps(tables, u, 4);
+                __m256 b2 = _mm256_i32gather_ps(tables, _mm256_add_epi32(u, next), 4);
+
+                __m256 a = _mm256_add_ps(a1, _mm256_mul_ps(mu, _mm256_sub_ps(a2, a1)));
+                __m256 b = _mm256_add_ps(b1, _mm256_mul_ps(mu, _mm256_sub_ps(b2, b1)));
+                __m256 y = _mm256_add_ps(a, _mm256_mul_ps(blend, _mm256_sub_ps(b, a)));
+                _mm256_store_ps(&acc[8 * i], _mm256_add_ps(_mm256_load_ps(&acc[8 * i]), _mm256_mul_ps(gain, y)));
+
+                phase = _mm256_add_ps(phase, increment);
+                phase = _mm256_sub_ps(phase, _mm256_cvtepi32_ps(_mm256_cvttps_epi32(phase)));
+                phase = _mm256_add_ps(phase, _mm256_and_ps(_mm256_cmp_ps(phase, zero, _CMP_LT_OQ), one));
+            }
+
+            // like the scalar kernel, the voices without gain keep their phase
+            phase = _mm256_blendv_ps(initialPhase, phase, audible);
+            _mm256_store_ps(&lanes.phase[v], phase);
+        }
+
+        // fold the 8 lanes to 4, and sum the lanes of 4 frames by transposition
+        auto fold = [&acc](unsigned i) -> __m128 {
+            __m256 y = _mm256_load_ps(&acc[8 * i]);
+            return _mm_add_ps(_mm256_castps256_ps128(y), _mm256_extractf128_ps(y, 1));
+        };
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 y0 = fold(i);
+            __m128 y1 = fold(i + 1);
+            __m128 y2 = fold(i + 2);
+            __m128 y3 = fold(i + 3);
+            _MM_TRANSPOSE4_PS(y0, y1, y2, y3);
+            _mm_storeu_ps(&output[offset + i], _mm_add_ps(_mm_add_ps(y0, y1), _mm_add_ps(y2, y3)));
+        }
+        for (; i < count; ++i) {
+            alignas(16) float y[4];
+            _mm_store_ps(y, fold(i));
+            output[offset + i] = (y[0] + y[1]) + (y[2] + y[3]);
+        }
+    }
+}
+
+} // namespace sfz
+
+#endif // defined(SFZ_HAVE_AVX2_KERNELS)
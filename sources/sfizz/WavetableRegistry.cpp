@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "WavetableRegistry.h"
+#include "Hash.h"
+#include <algorithm>
+
+namespace sfz {
+
+bool WavetableRegistry::Key::operator==(const Key& other) const
+{
+    return size == other.size && hash == other.hash && check == other.check;
+}
+
+bool WavetableRegistry::Key::operator<(const Key& other) const
+{
+    if (hash != other.hash)
+        return hash < other.hash;
+    if (check != other.check)
+        return check < other.check;
+    return size < other.size;
+}
+
+WavetableRegistry::~WavetableRegistry()
+{
+    delete _index.load();
+}
+
+WavetableRegistry& WavetableRegistry::global()
+{
+    static WavetableRegistry registry;
+    return registry;
+}
+
+WavetableRegistry::Pointer WavetableRegistry::findInIndex(const Index* index, const Key& key)
+{
+    if (!index)
+        return nullptr;
+
+    auto it = std::lower_bound(index->begin(), index->end(), key,
+        [](const Entry& entry, const Key& key) { return entry.key < key; });
+    if (it == index->end() || !(it->key == key))
+        return nullptr;
+
+    return it->wave.lock();
+}
+
+WavetableRegistry::Pointer WavetableRegistry::find(const Key& key) const
+{
+    // each lookup takes a reader slot of its own; when all of them are
+    // taken, it reads under the lock of the writers instead
+    const int reader = _reclaimer.addReader();
+    if (reader == -1) {
+        std::lock_guard<std::mutex> lock(_writeMutex);
+        return findInIndex(_index.load(), key);
+    }
+
+    _reclaimer.enter(reader);
+    Pointer wave = findInIndex(_index.load(), key);
+    _reclaimer.leave(reader);
+    _reclaimer.removeReader(reader);
+    return wave;
+}
+
+WavetableRegistry::Pointer WavetableRegistry::findOrCreate(const Key& key, const CreateFunction& create)
+{
+    Pointer wave = find(key);
+    if (wave)
+        return wave;
+
+    // the creation takes long, and it does not hold back the other writers
+    Pointer created = std::make_shared<const WavetableMulti>(create());
+
+    std::lock_guard<std::mutex> lock(_writeMutex);
+
+    // another thread may have registered it in the meantime, and then the
+    // one created here gets dropped
+    const Index* current = _index.load();
+    wave = findInIndex(current, key);
+    if (wave)
+        return wave;
+
+    wave = std::move(created);
+
+    // copy the index, without the entries whose multisamples were deleted
+    std::unique_ptr<Index> index(new Index);
+    if (current) {
+        index->reserve(current->size() + 1);
+        for (const Entry& entry : *current) {
+            if (!entry.wave.expired())
+                index->push_back(entry);
+        }
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.wave = wave;
+    auto it = std::lower_bound(index->begin(), index->end(), key,
+        [](const Entry& entry, const Key& key) { return entry.key < key; });
+    index->insert(it, std::move(entry));
+
+    _index.store(index.release());
+    if (current)
+        _reclaimer.retire(current);
+    _reclaimer.reclaim();
+
+    return wave;
+}
+
+WavetableRegistry::Pointer WavetableRegistry::getFromAudioData(
+    nonstd::span<const float> audio, double amplitude, unsigned tableSize,
+    double refSampleRate, unsigned numCycles)
+{
+    const Key key = getAudioDataKey(audio, amplitude, tableSize, refSampleRate, numCycles);
+    return findOrCreate(key, [&]() {
+        return WavetableMulti::createFromAudioData(audio, amplitude, tableSize, refSampleRate, numCycles);
+    });
+}
+
+WavetableRegistry::Key WavetableRegistry::getAudioDataKey(
+    nonstd::span<const float> audio, double amplitude, unsigned tableSize,
+    double refSampleRate, unsigned numCycles)
+{
+    Hasher hasher;
+    MixHasher checker;
+    auto update = [&hasher, &checker](const void* data, size_t size) {
+        hasher.update(data, size);
+        checker.update(data, size);
+    };
+    update(audio.data(), audio.size() * sizeof(float));
+    update(&amplitude, sizeof(amplitude));
+    update(&tableSize, sizeof(tableSize));
+    update(&refSampleRate, sizeof(refSampleRate));
+    update(&numCycles, sizeof(numCycles));
+
+    Key key;
+    key.size = audio.size();
+    key.hash = hasher.digest();
+    key.check = checker.digest();
+    return key;
+}
+
+size_t WavetableRegistry::size() const
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+
+    const Index* index = _index.load();
+    if (!index)
+        return 0;
+
+    return std::count_if(index->begin(), index->end(),
+        [](const Entry& entry) { return !entry.wave.expired(); });
+}
+
+} // namespace sfz
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include "Wavetables.h"
+#include "EpochReclaimer.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+namespace sfz {
+
+/**
+   A registry of the multisamples which are in use, identified by the key
+   of their content, so the instances which load identical contents share
+   one multisample.
+
+   The registry does not own the multisamples; it holds weak references, and
+   a multisample gets deleted when its last user releases it. The lookup is
+   lock-free: it reads an immutable index, which the insertions replace
+   under a lock, and the replaced indexes get reclaimed by epochs.
+ */
+class WavetableRegistry {
+public:
+    typedef std::shared_ptr<const WavetableMulti> Pointer;
+    typedef std::function<WavetableMulti()> CreateFunction;
+
+    // the identity of a multisample: the length of the content which it is
+    // made from, and two independent hashes of that content
+    struct Key {
+        uint64_t size = 0;
+        uint64_t hash = 0;
+        uint64_t check = 0;
+
+        bool operator==(const Key& other) const;
+        bool operator<(const Key& other) const;
+    };
+
+    WavetableRegistry() = default;
+    ~WavetableRegistry();
+
+    WavetableRegistry(const WavetableRegistry&) = delete;
+    WavetableRegistry& operator=(const WavetableRegistry&) = delete;
+
+    // get the registry of the process
+    static WavetableRegistry& global();
+
+    // find the multisample of a key, or null if there is none; lock-free
+    Pointer find(const Key& key) const;
+
+    // find the multisample of a key, or create and register it; the
+    // creation runs outside of the lock, so concurrent calls for one key
+    // may create it more than once, but all of them get the one registered.
+    Pointer findOrCreate(const Key& key, const CreateFunction& create);
+
+    // find or create the multisample of a single-cycle or multi-cycle wave
+    Pointer getFromAudioData(
+        nonstd::span<const float> audio, double amplitude, unsigned tableSize,
+        double refSampleRate = 44100, unsigned numCycles = 1);
+
+    // compute the key which identifies a multisample made from a wave
+    static Key getAudioDataKey(
+        nonstd::span<const float> audio, double amplitude, unsigned tableSize,
+        double refSampleRate = 44100, unsigned numCycles = 1);
+
+    // the number of multisamples which are registered and alive
+    size_t size() const;
+
+private:
+    struct Entry {
+        Key key;
+        std::weak_ptr<const WavetableMulti> wave;
+    };
+
+    // an immutable index of the entries, sorted by key
+    typedef std::vector<Entry> Index;
+
+    // find an entry in an index
+    static Pointer findInIndex(const Index* index, const Key& key);
+
+    std::atomic<const Index*> _index { nullptr };
+    mutable EpochReclaimer _reclaimer;
+    mutable std::mutex _writeMutex;
+};
+
+} // namespace sfz
@@ -0,0 +1,244 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "WavetableUnison.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SFZ_WAVETABLES_SSE2 1
+#endif
+
+namespace sfz {
+
+void WavetableUnison::init(double sampleRate)
+{
+    _sampleInterval = 1.0 / sampleRate;
+    clear();
+}
+
+void WavetableUnison::clear()
+{
+    // spread the initial phases by the golden ratio, so that the voices do
+    // not start in phase
+    for (unsigned v = 0; v < maxVoices; ++v) {
+        double phase = v * 0.6180339887498949;
+        _phases[v] = static_cast<float>(phase - std::floor(phase));
+    }
+}
+
+void WavetableUnison::setWavetable(const WavetableMulti* wave)
+{
+    _multi = wave;
+}
+
+void WavetableUnison::setVoices(unsigned numVoices, float detune)
+{
+    numVoices = std::min(numVoices, maxVoices);
+    _numVoices = numVoices;
+
+    const float gain = (numVoices > 0) ? (1.0f / std::sqrt(static_cast<float>(numVoices))) : 0.0f;
+
+    for (unsigned v = 0; v < maxVoices; ++v) {
+        if (v >= numVoices) {
+            _ratios[v] = 0.0f;
+            _gains[v] = 0.0f;
+            continue;
+        }
+        float spread = (numVoices > 1) ? (2.0f * v / (numVoices - 1) - 1.0f) : 0.0f;
+        _ratios[v] = std::exp2(spread * detune * (1.0f / 1200.0f));
+        _gains[v] = gain;
+    }
+}
+
+namespace {
+
+// the tables which each voice reads, in groups of 4 voices
+struct UnisonTables {
+    const float* lower[WavetableUnison::maxVoices];
+    const float* upper[WavetableUnison::maxVoices];
+    const float* pair[WavetableUnison::maxVoices];
+    alignas(16) float blend[WavetableUnison::maxVoices];
+};
+
+#if defined(SFZ_WAVETABLES_SSE2)
+/**
+ * @brief Read a group of 4 voices with linear interpolation, and crossfade
+ * the tables of each.
+ */
+template <bool Interleaved>
+inline __m128 readVoiceGroup(const UnisonTables& t, unsigned v, __m128 phase, __m128 size)
+{
+    __m128 pos = _mm_mul_ps(phase, size);
+    __m128i ipos = _mm_cvttps_epi32(pos);
+    __m128 mu = _mm_sub_ps(pos, _mm_cvtepi32_ps(ipos));
+
+    alignas(16) int32_t j[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(j), ipos);
+
+    __m128 a1, a2, b1, b2;
+    if (Interleaved) {
+        // each load gets 2 frames of the pair: lower, upper, lower+1, upper+1
+        a1 = _mm_loadu_ps(t.pair[v] + 2 * j[0]);
+        b1 = _mm_loadu_ps(t.pair[v + 1] + 2 * j[1]);
+        a2 = _mm_loadu_ps(t.pair[v + 2] + 2 * j[2]);
+        b2 = _mm_loadu_ps(t.pair[v + 3] + 2 * j[3]);
+        _MM_TRANSPOSE4_PS(a1, b1, a2, b2);
+    }
+    else {
+        const float* const* lower = &t.lower[v];
+        const float* const* upper = &t.upper[v];
+        a1 = _mm_setr_ps(lower[0][j[0]], lower[1][j[1]], lower[2][j[2]], lower[3][j[3]]);
+        a2 = _mm_setr_ps(lower[0][j[0] + 1], lower[1][j[1] + 1], lower[2][j[2] + 1], lower[3][j[3] + 1]);
+        b1 = _mm_setr_ps(upper[0][j[0]], upper[1][j[1]], upper[2][j[2]], upper[3][j[3]]);
+        b2 = _mm_setr_ps(upper[0][j[0] + 1], upper[1][j[1] + 1], upper[2][j[2] + 1], upper[3][j[3] + 1]);
+    }
+
+    __m128 blend = _mm_load_ps(&t.blend[v]);
+    __m128 a = _mm_add_ps(a1, _mm_mul_ps(mu, _mm_sub_ps(a2, a1)));
+    __m128 b = _mm_add_ps(b1, _mm_mul_ps(mu, _mm_sub_ps(b2, b1)));
+    return _mm_add_ps(a, _mm_mul_ps(blend, _mm_sub_ps(b, a)));
+}
+
+inline __m128 advancePhase(__m128 phase, __m128 inc)
+{
+    phase = _mm_add_ps(phase, inc);
+    phase = _mm_sub_ps(phase, _mm_cvtepi32_ps(_mm_cvttps_epi32(phase)));
+    return _mm_add_ps(phase, _mm_and_ps(_mm_cmplt_ps(phase, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+}
+#endif
+
+/**
+ * @brief Render the mix of the voices, which are processed as SIMD lanes.
+ */
+template <bool Interleaved>
+void renderUnison(
+    const UnisonTables& t, unsigned tableSize, unsigned numVoices,
+    float* phases, const float* incs, const float* gains,
+    float* output, unsigned nframes)
+{
+#if defined(SFZ_WAVETABLES_SSE2)
+    constexpr unsigned maxGroups = WavetableUnison::maxVoices / 4;
+    const unsigned numGroups = (numVoices + 3) / 4;
+    const __m128 size = _mm_set1_ps(static_cast<float>(tableSize));
+
+    __m128 phase[maxGroups];
+    __m128 inc[maxGroups];
+    __m128 gain[maxGroups];
+    for (unsigned g = 0; g < numGroups; ++g) {
+        phase[g] = _mm_load_ps(&phases[4 * g]);
+        inc[g] = _mm_load_ps(&incs[4 * g]);
+        gain[g] = _mm_load_ps(&gains[4 * g]);
+    }
+
+    auto renderFrame = [&]() -> __m128 {
+        __m128 sum = _mm_setzero_ps();
+        for (unsigned g = 0; g < numGroups; ++g) {
+            __m128 y = readVoiceGroup<Interleaved>(t, 4 * g, phase[g], size);
+            sum = _mm_add_ps(sum, _mm_mul_ps(gain[g], y));
+            phase[g] = advancePhase(phase[g], inc[g]);
+        }
+        return sum;
+    };
+
+    unsigned i = 0;
+    for (; i + 4 <= nframes; i += 4) {
+        // sum the lanes of 4 frames at once, by transposition
+        __m128 y0 = renderFrame();
+        __m128 y1 = renderFrame();
+        __m128 y2 = renderFrame();
+        __m128 y3 = renderFrame();
+        _MM_TRANSPOSE4_PS(y0, y1, y2, y3);
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_add_ps(y0, y1), _mm_add_ps(y2, y3)));
+    }
+    for (; i < nframes; ++i) {
+        alignas(16) float y[4];
+        _mm_store_ps(y, renderFrame());
+        output[i] = (y[0] + y[1]) + (y[2] + y[3]);
+    }
+
+    for (unsigned g = 0; g < numGroups; ++g)
+        _mm_store_ps(&phases[4 * g], phase[g]);
+#else
+    for (unsigned i = 0; i < nframes; ++i) {
+        float sum = 0.0f;
+        for (unsigned v = 0; v < numVoices; ++v) {
+            float pos = phases[v] * tableSize;
+            unsigned j = static_cast<unsigned>(pos);
+            float mu = pos - j;
+            float a, b;
+            if (Interleaved) {
+                const float* y = t.pair[v] + 2 * j;
+                a = y[0] + mu * (y[2] - y[0]);
+                b = y[1] + mu * (y[3] - y[1]);
+            }
+            else {
+                const float* lower = t.lower[v];
+                const float* upper = t.upper[v];
+                a = lower[j] + mu * (lower[j + 1] - lower[j]);
+                b = upper[j] + mu * (upper[j + 1] - upper[j]);
+            }
+            sum += gains[v] * (a + t.blend[v] * (b - a));
+
+            float phase = phases[v] + incs[v];
+            phase -= static_cast<int>(phase);
+            phase += (phase < 0.0f) ? 1.0f : 0.0f;
+            phases[v] = phase;
+        }
+        output[i] = sum;
+    }
+#endif
+}
+
+} // namespace
+
+void WavetableUnison::process(float frequency, float* output, unsigned nframes)
+{
+    const WavetableMulti* multi = _multi;
+    const unsigned numVoices = _numVoices;
+    if (!multi || numVoices == 0) {
+        std::fill(output, output + nframes, 0.0f);
+        return;
+    }
+
+    // select the tables of each voice; the voices past the last, which have
+    // no gain, read the tables of the last voice.
+    const float absFrequency = std::fabs(frequency);
+    const float lowest = absFrequency * _ratios[0];
+    const float highest = absFrequency * _ratios[numVoices - 1];
+    const bool shared =
+        static_cast<unsigned>(MipmapRange::getIndexForFrequency(lowest)) ==
+        static_cast<unsigned>(MipmapRange::getIndexForFrequency(highest));
+    _sharedTables = shared;
+
+    const bool interleaved = multi->hasInterleavedPairs();
+    const unsigned paddedVoices = (numVoices + 3) / 4 * 4;
+
+    UnisonTables t;
+    alignas(16) float incs[maxVoices];
+    WavetableMulti::TablePair pair;
+    if (shared)
+        pair = multi->getTablePairForFrequency(highest);
+
+    for (unsigned v = 0; v < paddedVoices; ++v) {
+        unsigned voice = std::min(v, numVoices - 1);
+        if (!shared)
+            pair = multi->getTablePairForFrequency(absFrequency * _ratios[voice]);
+        t.lower[v] = pair.lower.data();
+        t.upper[v] = pair.upper.data();
+        t.pair[v] = interleaved ? multi->getInterleavedPair(pair.index) : nullptr;
+        t.blend[v] = pair.blend;
+        incs[v] = frequency * _ratios[v] * _sampleInterval;
+    }
+
+    const unsigned tableSize = multi->tableSize();
+    if (interleaved)
+        renderUnison<true>(t, tableSize, numVoices, _phases, incs, _gains, output, nframes);
+    else
+        renderUnison<false>(t, tableSize, numVoices, _phases, incs, _gains, output, nframes);
+}
+
+} // namespace sfz
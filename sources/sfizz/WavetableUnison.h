@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include "Wavetables.h"
+
+namespace sfz {
+
+/**
+   A unison of detuned voices which read the same multisample, such as the
+   voices of a supersaw.
+
+   The voices are processed as the lanes of SIMD vectors. When the frequencies
+   of all the voices fall in the same range of the mipmap, the voices share
+   the tables selected for the highest voice.
+ */
+class WavetableUnison {
+public:
+    // maximum number of voices
+    static constexpr unsigned maxVoices = 16;
+
+    // initialize with the given sample rate
+    void init(double sampleRate);
+
+    // reset the voices to their initial phases, which are spread apart
+    void clear();
+
+    // set the multisample to play; it must outlive the unison
+    void setWavetable(const WavetableMulti* wave);
+
+    // set the number of voices, spread evenly in the range of +/- detune
+    // cents around the frequency
+    void setVoices(unsigned numVoices, float detune);
+
+    // get the number of voices
+    unsigned numVoices() const { return _numVoices; }
+
+    // whether the voices shared the selection of tables in the last block
+    bool hasSharedTables() const { return _sharedTables; }
+
+    // compute a block of the mix of the voices at a constant frequency
+    void process(float frequency, float* output, unsigned nframes);
+
+private:
+    alignas(16) float _phases[maxVoices] {};
+    // frequency ratio of each voice, in increasing order
+    alignas(16) float _ratios[maxVoices] {};
+    // gain of each voice, zero for the voices past the last
+    alignas(16) float _gains[maxVoices] {};
+    unsigned _numVoices = 0;
+    float _sampleInterval = 0.0f;
+    bool _sharedTables = false;
+    const WavetableMulti* _multi = nullptr;
+};
+
+} // namespace sfz
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#include "WavetableVoices.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sfz {
+
+WavetableVoices::WavetableVoices()
+{
+    setKernel(bestVoiceKernel());
+}
+
+void WavetableVoices::init(double sampleRate, unsigned maxVoices)
+{
+    _sampleInterval = 1.0 / sampleRate;
+    _maxVoices = maxVoices;
+
+    const unsigned numLanes = (maxVoices + voiceLaneAlignment - 1) / voiceLaneAlignment * voiceLaneAlignment;
+    _frequency.assign(numLanes, 0.0f);
+    _gain.assign(numLanes, 0.0f);
+    _phase.assign(numLanes, 0.0f);
+    _increment.assign(numLanes, 0.0f);
+    _blend.assign(numLanes, 0.0f);
+    _lower.assign(numLanes, 0);
+    _upper.assign(numLanes, 0);
+}
+
+void WavetableVoices::clear()
+{
+    std::fill(_frequency.begin(), _frequency.end(), 0.0f);
+    std::fill(_gain.begin(), _gain.end(), 0.0f);
+    std::fill(_phase.begin(), _phase.end(), 0.0f);
+}
+
+void WavetableVoices::setWavetable(const WavetableMulti* wave)
+{
+    _multi = wave;
+}
+
+void WavetableVoices::setVoice(unsigned voice, float frequency, float gain)
+{
+    assert(voice < _maxVoices);
+    _frequency[voice] = frequency;
+    _gain[voice] = gain;
+}
+
+void WavetableVoices::setVoicePhase(unsigned voice, float phase)
+{
+    assert(voice < _maxVoices);
+    assert(phase >= 0.0f && phase < 1.0f);
+    _phase[voice] = phase;
+}
+
+void WavetableVoices::setKernel(VoiceKernel kernel)
+{
+    assert(isVoiceKernelSupported(kernel));
+    _kernel = kernel;
+    _mixVoices = getMixVoicesFunction(kernel);
+}
+
+void WavetableVoices::process(float* output, unsigned nframes)
+{
+    const WavetableMulti* multi = _multi;
+    if (!multi || _maxVoices == 0) {
+        std::fill(output, output + nframes, 0.0f);
+        return;
+    }
+
+    // select the tables of each voice, as offsets from the first table
+    const float* tables = multi->getTable(0).data();
+    const unsigned numLanes = static_cast<unsigned>(_gain.size());
+    for (unsigned v = 0; v < numLanes; ++v) {
+        const float frequency = _frequency[v];
+        const WavetableMulti::TablePair pair = multi->getTablePairForFrequency(std::fabs(frequency));
+        _lower[v] = static_cast<int32_t>(pair.lower.data() - tables);
+        _upper[v] = static_cast<int32_t>(pair.upper.data() - tables);
+        _blend[v] = pair.blend;
+        _increment[v] = frequency * _sampleInterval;
+    }
+
+    VoiceLanes lanes;
+    lanes.tables = tables;
+    lanes.lower = _lower.data();
+    lanes.upper = _upper.data();
+    lanes.blend = _blend.data();
+    lanes.phase = _phase.data();
+    lanes.increment = _increment.data();
+    lanes.gain = _gain.data();
+    lanes.count = numLanes;
+
+    _mixVoices(lanes, multi->tableSize(), output, nframes);
+}
+
+} // namespace sfz
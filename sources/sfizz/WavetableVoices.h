@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-2-Clause
+
+// This code is part of the sfizz library and is licensed under a BSD 2-clause
+// license. You should have receive a LICENSE.md file along with the code.
+// If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
+
+#pragma once
+#include "Wavetables.h"
+#include "WavetableKernels.h"
+#include "AlignedAllocator.h"
+#include <vector>
+
+namespace sfz {
+
+/**
+   A bank of voices which read the same multisample, each at its own
+   frequency and gain, and which get mixed together.
+
+   The voices are processed as the lanes of SIMD vectors, by a kernel which
+   is selected at run time according to the processor: AVX2 with 8 voices
+   per vector, SSE2 with 4, or scalar.
+ */
+class WavetableVoices {
+public:
+    WavetableVoices();
+
+    // initialize with the given sample rate and capacity of voices
+    void init(double sampleRate, unsigned maxVoices);
+
+    // reset all the voices to the initial phase, and silence them
+    void clear();
+
+    // set the multisample to play; it must outlive the voices
+    void setWavetable(const WavetableMulti* wave);
+
+    // get the maximum number of voices
+    unsigned maxVoices() const { return _maxVoices; }
+
+    // set the frequency and gain of a voice; a voice with no gain is silent
+    void setVoice(unsigned voice, float frequency, float gain);
+
+    // set the current phase of a voice, in the range [0:1)
+    void setVoicePhase(unsigned voice, float phase);
+
+    // select the kernel, which must be supported by the processor
+    void setKernel(VoiceKernel kernel);
+
+    // get the selected kernel
+    VoiceKernel kernel() const { return _kernel; }
+
+    // compute a block of the mix of the voices
+    void process(float* output, unsigned nframes);
+
+private:
+    typedef std::vector<float, AlignedAllocator<float, 64>> FloatLanes;
+    typedef std::vector<int32_t, AlignedAllocator<int32_t, 64>> IndexLanes;
+
+    unsigned _maxVoices = 0;
+    float _sampleInterval = 0.0f;
+    const WavetableMulti* _multi = nullptr;
+    VoiceKernel _kernel = VoiceKernel::Scalar;
+    MixVoicesFunction _mixVoices = nullptr;
+
+    FloatLanes _frequency;
+    FloatLanes _gain;
+    FloatLanes _phase;
+    FloatLanes _increment;
+    FloatLanes _blend;
+    IndexLanes _lower;
+    IndexLanes _upper;
+};
+
+} // namespace sfz
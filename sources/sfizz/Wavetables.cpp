@@ -5,8 +5,13 @@
 // If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
 
 #include "Wavetables.h"
+#include "FFT.h"
 #include "absl/meta/type_traits.h"
-#include <kiss_fftr.h>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SFZ_WAVETABLES_SSE2 1
+#endif
 
 namespace sfz {
 
@@ -22,15 +27,13 @@ void HarmonicProfile::generate(
 {
     size_t size = table.size();
 
-    typedef std::complex<kiss_fft_scalar> cpx;
+    typedef std::complex<float> cpx;
 
     // allocate a spectrum of size N/2+1
     // bins are equispaced in frequency, with index N/2 being nyquist
     std::unique_ptr<cpx[]> spec(new cpx[size / 2 + 1]());
 
-    kiss_fftr_cfg cfg = kiss_fftr_alloc(size, true, nullptr, nullptr);
-    if (!cfg)
-        throw std::bad_alloc();
+    RealFFT& fft = getCachedRealFFT(size);
 
     // bins need scaling and phase offset; this IFFT is a sum of cosines
     const std::complex<double> k = std::polar(amplitude * 0.5, M_PI / 2);
@@ -44,8 +47,7 @@ void HarmonicProfile::generate(
         spec[index] = k * harmonic;
     }
 
-    kiss_fftri(cfg, reinterpret_cast<kiss_fft_cpx*>(spec.get()), table.data());
-    kiss_fftr_free(cfg);
+    fft.inverse(spec.get(), table.data());
 }
 
 //------------------------------------------------------------------------------
@@ -122,119 +124,614 @@ MipmapRange MipmapRange::getRangeForFrequency(float f)
 
 //------------------------------------------------------------------------------
 constexpr unsigned WavetableMulti::_tableExtra;
+constexpr unsigned WavetableMulti::_tableAlignment;
+constexpr unsigned WavetableMulti::_alignedElements;
+constexpr unsigned WavetableMulti::_tableLead;
+constexpr unsigned WavetableMulti::_pairLead;
 
 WavetableMulti WavetableMulti::createForHarmonicProfile(
-    const HarmonicProfile& hp, double amplitude, unsigned tableSize, double refSampleRate)
+    const HarmonicProfile& hp, double amplitude, unsigned tableSize, double refSampleRate,
+    const StageCallback& onStage)
 {
     WavetableMulti wm;
     constexpr unsigned numTables = WavetableMulti::numTables();
 
+    if (onStage)
+        onStage(CreationStage::Synthesis);
+
     wm.allocateStorage(tableSize);
 
     for (unsigned m = 0; m < numTables; ++m) {
-        MipmapRange range = MipmapRange::getRangeForIndex(m);
-
-        double freq = range.maxFrequency;
-
-        // A spectrum S of fundamental F has: S[1]=F and S[N/2]=Fs'/2
-        // which lets it generate frequency up to Fs'/2=F*N/2.
-        // Therefore it's desired to cut harmonics at C=0.5*Fs/Fs'=0.5*Fs/(F*N).
-        double cutoff = (0.5 * refSampleRate / tableSize) / freq;
-
         float* ptr = const_cast<float*>(wm.getTablePointer(m));
         nonstd::span<float> table(ptr, tableSize);
 
-        hp.generate(table, amplitude, cutoff);
+        generateTable(hp, m, table, amplitude, refSampleRate);
     }
 
+    if (onStage)
+        onStage(CreationStage::FillExtra);
+
     wm.fillExtra();
 
+    if (onStage)
+        onStage(CreationStage::Done);
+
     return wm;
 }
 
+void WavetableMulti::generateForHarmonicProfile(
+    const HarmonicProfile& hp, const TableCallback& callback,
+    double amplitude, unsigned tableSize, double refSampleRate)
+{
+    constexpr unsigned numTables = WavetableMulti::numTables();
+
+    std::unique_ptr<float[]> buffer { new float[tableSize] };
+    nonstd::span<float> table(buffer.get(), tableSize);
+
+    for (unsigned m = 0; m < numTables; ++m) {
+        generateTable(hp, m, table, amplitude, refSampleRate);
+        callback(m, table);
+    }
+}
+
+void WavetableMulti::generateTable(
+    const HarmonicProfile& hp, unsigned index, nonstd::span<float> table,
+    double amplitude, double refSampleRate)
+{
+    size_t tableSize = table.size();
+    MipmapRange range = MipmapRange::getRangeForIndex(index);
+
+    double freq = range.maxFrequency;
+
+    // A spectrum S of fundamental F has: S[1]=F and S[N/2]=Fs'/2
+    // which lets it generate frequency up to Fs'/2=F*N/2.
+    // Therefore it's desired to cut harmonics at C=0.5*Fs/Fs'=0.5*Fs/(F*N).
+    double cutoff = (0.5 * refSampleRate / tableSize) / freq;
+
+    hp.generate(table, amplitude, cutoff);
+}
+
 void WavetableMulti::allocateStorage(unsigned tableSize)
 {
-    _multiData.resize((tableSize + 2 * _tableExtra) * numTables());
+    // the table with its right extra, padded to the end of the cache line
+    unsigned tail = tableSize + _tableExtra;
+    tail = (tail + _alignedElements - 1) / _alignedElements * _alignedElements;
+
+    _tableStride = _tableLead + tail;
+    _multiData.resize(_tableStride * numTables());
     _tableSize = tableSize;
+    _storedTables = numTables();
+
+    _pairStride = 0;
+    _pairData.clear();
 }
 
 void WavetableMulti::fillExtra()
+{
+    for (unsigned m = 0; m < _storedTables; ++m)
+        fillExtra(m);
+}
+
+void WavetableMulti::fillExtra(unsigned index)
 {
     unsigned tableSize = _tableSize;
     constexpr unsigned tableExtra = _tableExtra;
-    constexpr unsigned numTables = WavetableMulti::numTables();
+
+    float* beg = const_cast<float*>(getTablePointer(index));
+    float* end = beg + tableSize;
+    // fill right
+    float* src = beg;
+    float* dst = end;
+    for (unsigned i = 0; i < tableExtra; ++i) {
+        *dst++ = *src;
+        src = (src + 1 != end) ? (src + 1) : beg;
+    }
+    // fill left
+    src = end - 1;
+    dst = beg - 1;
+    for (unsigned i = 0; i < tableExtra; ++i) {
+        *dst-- = *src;
+        src = (src != beg) ? (src - 1) : (end - 1);
+    }
+}
+
+void WavetableMulti::regenerateTable(
+    unsigned index, const HarmonicProfile& hp, double amplitude, double refSampleRate)
+{
+    float* ptr = const_cast<float*>(getTablePointer(index));
+    nonstd::span<float> table(ptr, _tableSize);
+
+    generateTable(hp, index, table, amplitude, refSampleRate);
+    fillExtra(index);
+}
+
+void WavetableMulti::copyTable(unsigned index, const WavetableMulti& other)
+{
+    assert(other._tableSize == _tableSize);
+
+    const float* src = other.getTablePointer(index) - _tableExtra;
+    float* dst = const_cast<float*>(getTablePointer(index)) - _tableExtra;
+    std::copy(src, src + _tableSize + 2 * _tableExtra, dst);
+}
+
+void WavetableMulti::interleavePairs()
+{
+    unsigned tableSize = _tableSize;
+    constexpr unsigned tableExtra = _tableExtra;
+    const unsigned numTables = _storedTables;
+
+    unsigned tail = 2 * (tableSize + tableExtra);
+    tail = (tail + _alignedElements - 1) / _alignedElements * _alignedElements;
+
+    _pairStride = _pairLead + tail;
+    _pairData.resize(_pairStride * numTables);
 
     for (unsigned m = 0; m < numTables; ++m) {
-        float* beg = const_cast<float*>(getTablePointer(m));
-        float* end = beg + tableSize;
-        // fill right
-        float* src = beg;
-        float* dst = end;
-        for (unsigned i = 0; i < tableExtra; ++i) {
-            *dst++ = *src;
-            src = (src + 1 != end) ? (src + 1) : beg;
-        }
-        // fill left
-        src = end - 1;
-        dst = beg - 1;
-        for (unsigned i = 0; i < tableExtra; ++i) {
-            *dst-- = *src;
-            src = (src != beg) ? (src - 1) : (end - 1);
+        // copy the extra elements also, which are already filled
+        const float* src1 = getTablePointer(m) - tableExtra;
+        const float* src2 = getTablePointer(std::min(m + 1, numTables - 1)) - tableExtra;
+        float* dst = const_cast<float*>(getInterleavedPair(m)) - 2 * tableExtra;
+        for (unsigned i = 0; i < tableSize + 2 * tableExtra; ++i) {
+            dst[2 * i] = src1[i];
+            dst[2 * i + 1] = src2[i];
         }
     }
 }
 
+void WavetableMulti::releaseTables(unsigned firstIndex)
+{
+    _storedTables = std::min(firstIndex, _storedTables);
+    _multiData.resize(_tableStride * _storedTables);
+    _multiData.shrink_to_fit();
+
+    _pairStride = 0;
+    _pairData.clear();
+    _pairData.shrink_to_fit();
+}
+
+//------------------------------------------------------------------------------
+typedef std::complex<float> SpectrumBin;
+
+std::vector<SpectrumBin> WavetableMulti::analyzeAudioData(
+    nonstd::span<const float> audioData, unsigned tableSize, unsigned numCycles)
+{
+    const size_t dataSize = audioData.size();
+    const size_t specSize = tableSize / 2 + 1;
+
+    // the harmonic H of the waveform is the bin H*C of the data; the bins
+    // above the Nyquist frequency of the data are zero, and not stored
+    const size_t numBins = std::min<size_t>(
+        (specSize - 1) * static_cast<size_t>(numCycles) + 1, dataSize / 2 + 1);
+    std::vector<SpectrumBin> bins(numBins);
+    computeRealDFT(audioData, bins);
+
+    std::vector<SpectrumBin> spec(specSize);
+
+    // scale transform, and normalize amplitude and phase
+    const std::complex<double> k = std::polar(2.0 / dataSize, -M_PI / 2);
+    for (size_t i = 0; i < specSize && i * numCycles < numBins; ++i)
+        spec[i] = SpectrumBin(k * std::complex<double>(bins[i * numCycles]));
+
+    return spec;
+}
+
+WavetableMulti WavetableMulti::createFromAudioData(
+    nonstd::span<const float> audioData, double amplitude, unsigned tableSize,
+    double refSampleRate, unsigned numCycles)
+{
+    const std::vector<SpectrumBin> spec = analyzeAudioData(audioData, tableSize, numCycles);
+    TabulatedHarmonicProfile hp { spec };
+
+    return WavetableMulti::createForHarmonicProfile(hp, amplitude, tableSize, refSampleRate);
+}
+
+void WavetableMulti::generateFromAudioData(
+    nonstd::span<const float> audioData, const TableCallback& callback,
+    double amplitude, unsigned tableSize, double refSampleRate, unsigned numCycles)
+{
+    const std::vector<SpectrumBin> spec = analyzeAudioData(audioData, tableSize, numCycles);
+    TabulatedHarmonicProfile hp { spec };
+
+    WavetableMulti::generateForHarmonicProfile(hp, callback, amplitude, tableSize, refSampleRate);
+}
+
 //------------------------------------------------------------------------------
+void WavetablePhasor::init(double sampleRate)
+{
+    _sampleInterval = 1.0 / sampleRate;
+    clear();
+}
+
+void WavetablePhasor::clear()
+{
+    _phase = 0.0f;
+}
+
+void WavetablePhasor::setPhase(float phase)
+{
+    assert(phase >= 0.0f && phase < 1.0f);
+    _phase = phase;
+}
+
+void WavetablePhasor::computePhases(float phaseInc, float* phases, unsigned nframes)
+{
+    float phase = _phase;
+    for (unsigned i = 0; i < nframes; ++i) {
+        phases[i] = phase;
+        phase += phaseInc;
+        phase -= static_cast<int>(phase);
+        phase += (phase < 0.0f) ? 1.0f : 0.0f;
+    }
+    _phase = phase;
+}
+
+void WavetablePhasor::process(float frequency, float* phases, unsigned nframes)
+{
+    computePhases(frequency * _sampleInterval, phases, nframes);
+}
+
+void WavetablePhasor::processModulated(const float* frequencies, float* phases, unsigned nframes)
+{
+    const float sampleInterval = _sampleInterval;
+    for (unsigned i = 0; i < nframes; ++i)
+        computePhases(frequencies[i] * sampleInterval, &phases[i], 1);
+}
+
+/**
+ * @brief Get the size of the tables, which is known at compile time if
+ * `TableSize` is not zero.
+ */
+template <unsigned TableSize>
+static inline unsigned fixedTableSize(unsigned tableSize)
+{
+    static_assert((TableSize & (TableSize - 1)) == 0, "The table size must be a power of two");
+    return TableSize ? TableSize : tableSize;
+}
+
+/**
+ * @brief Wrap an index into the table, which only the fixed sizes do, by
+ * masking; it guards against rounding of the phase up to 1.
+ */
+template <unsigned TableSize>
+static inline unsigned wrapTableIndex(unsigned j)
+{
+    return TableSize ? (j & (TableSize - 1)) : j;
+}
 
 /**
- * @brief Harmonic profile which takes its values from a table.
+ * @brief Interpolate 4 points around the position `mu` in [0:1] between the
+ * middle points, using the cubic Hermite (Catmull-Rom) polynomial.
  */
-class TabulatedHarmonicProfile : public HarmonicProfile {
-public:
-    explicit TabulatedHarmonicProfile(nonstd::span<const std::complex<float>> harmonics)
-        : _harmonics(harmonics)
-    {
+static inline float interpolateHermite3(float ym1, float y0, float y1, float y2, float mu)
+{
+    float c1 = 0.5f * (y1 - ym1);
+    float c2 = ym1 - 2.5f * y0 + 2.0f * y1 - 0.5f * y2;
+    float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+    return ((c3 * mu + c2) * mu + c1) * mu + y0;
+}
+
+#if defined(SFZ_WAVETABLES_SSE2)
+static inline __m128 interpolateHermite3(__m128 ym1, __m128 y0, __m128 y1, __m128 y2, __m128 mu)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 c1 = _mm_mul_ps(half, _mm_sub_ps(y1, ym1));
+    __m128 c2 = _mm_sub_ps(
+        _mm_add_ps(ym1, _mm_add_ps(y1, y1)),
+        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.5f), y0), _mm_mul_ps(half, y2)));
+    __m128 c3 = _mm_add_ps(
+        _mm_mul_ps(half, _mm_sub_ps(y2, ym1)),
+        _mm_mul_ps(_mm_set1_ps(1.5f), _mm_sub_ps(y0, y1)));
+    __m128 y = _mm_add_ps(_mm_mul_ps(c3, mu), c2);
+    y = _mm_add_ps(_mm_mul_ps(y, mu), c1);
+    return _mm_add_ps(_mm_mul_ps(y, mu), y0);
+}
+#endif
+
+/**
+ * @brief Read two tables with interpolation of the given order, linear (1)
+ * or cubic (3), and crossfade them.
+ *
+ * If `TableSize` is not zero, it is the size of the tables, a power of two.
+ */
+template <unsigned TableSize, unsigned Order>
+static void readCrossfadePlanar(
+    const float* lower, const float* upper, float blend, unsigned tableSize,
+    const float* phases, float* output, unsigned nframes)
+{
+    static_assert(Order == 1 || Order == 3, "The interpolation order must be 1 or 3");
+    const unsigned size = fixedTableSize<TableSize>(tableSize);
+    unsigned i = 0;
+
+#if defined(SFZ_WAVETABLES_SSE2)
+    const __m128 vSize = _mm_set1_ps(static_cast<float>(size));
+    const __m128 vBlend = _mm_set1_ps(blend);
+    const __m128i vMask = _mm_set1_epi32(TableSize ? (TableSize - 1) : -1);
+    for (; i + 4 <= nframes; i += 4) {
+        __m128 pos = _mm_mul_ps(_mm_loadu_ps(phases + i), vSize);
+        __m128i ipos = _mm_cvttps_epi32(pos);
+        __m128 mu = _mm_sub_ps(pos, _mm_cvtepi32_ps(ipos));
+        if (TableSize)
+            ipos = _mm_and_si128(ipos, vMask);
+
+        alignas(16) int32_t j[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(j), ipos);
+
+        __m128 a, b;
+        if (Order == 1) {
+            __m128 a1 = _mm_setr_ps(lower[j[0]], lower[j[1]], lower[j[2]], lower[j[3]]);
+            __m128 a2 = _mm_setr_ps(lower[j[0] + 1], lower[j[1] + 1], lower[j[2] + 1], lower[j[3] + 1]);
+            __m128 b1 = _mm_setr_ps(upper[j[0]], upper[j[1]], upper[j[2]], upper[j[3]]);
+            __m128 b2 = _mm_setr_ps(upper[j[0] + 1], upper[j[1] + 1], upper[j[2] + 1], upper[j[3] + 1]);
+            a = _mm_add_ps(a1, _mm_mul_ps(mu, _mm_sub_ps(a2, a1)));
+            b = _mm_add_ps(b1, _mm_mul_ps(mu, _mm_sub_ps(b2, b1)));
+        }
+        else {
+            // the guard elements around the tables make the points valid
+            const float* l0 = lower + j[0] - 1;
+            const float* l1 = lower + j[1] - 1;
+            const float* l2 = lower + j[2] - 1;
+            const float* l3 = lower + j[3] - 1;
+            const float* u0 = upper + j[0] - 1;
+            const float* u1 = upper + j[1] - 1;
+            const float* u2 = upper + j[2] - 1;
+            const float* u3 = upper + j[3] - 1;
+            a = interpolateHermite3(
+                _mm_setr_ps(l0[0], l1[0], l2[0], l3[0]), _mm_setr_ps(l0[1], l1[1], l2[1], l3[1]),
+                _mm_setr_ps(l0[2], l1[2], l2[2], l3[2]), _mm_setr_ps(l0[3], l1[3], l2[3], l3[3]), mu);
+            b = interpolateHermite3(
+                _mm_setr_ps(u0[0], u1[0], u2[0], u3[0]), _mm_setr_ps(u0[1], u1[1], u2[1], u3[1]),
+                _mm_setr_ps(u0[2], u1[2], u2[2], u3[2]), _mm_setr_ps(u0[3], u1[3], u2[3], u3[3]), mu);
+        }
+        _mm_storeu_ps(output + i, _mm_add_ps(a, _mm_mul_ps(vBlend, _mm_sub_ps(b, a))));
+    }
+#endif
+
+    for (; i < nframes; ++i) {
+        float pos = phases[i] * size;
+        unsigned j = static_cast<unsigned>(pos);
+        float mu = pos - j;
+        j = wrapTableIndex<TableSize>(j);
+        float a, b;
+        if (Order == 1) {
+            a = lower[j] + mu * (lower[j + 1] - lower[j]);
+            b = upper[j] + mu * (upper[j + 1] - upper[j]);
+        }
+        else {
+            const float* l = lower + j - 1;
+            const float* u = upper + j - 1;
+            a = interpolateHermite3(l[0], l[1], l[2], l[3], mu);
+            b = interpolateHermite3(u[0], u[1], u[2], u[3], mu);
+        }
+        output[i] = a + blend * (b - a);
     }
+}
 
-    std::complex<double> getHarmonic(size_t index) const override
-    {
-        if (index >= _harmonics.size())
-            return {};
+/**
+ * @brief Read an interleaved pair of tables with linear interpolation, and
+ * crossfade them.
+ *
+ * If `TableSize` is not zero, it is the size of the tables, a power of two.
+ */
+template <unsigned TableSize>
+static void readCrossfadeInterleaved(
+    const float* pair, float blend, unsigned tableSize,
+    const float* phases, float* output, unsigned nframes)
+{
+    const unsigned size = fixedTableSize<TableSize>(tableSize);
+    unsigned i = 0;
+
+#if defined(SFZ_WAVETABLES_SSE2)
+    const __m128 vSize = _mm_set1_ps(static_cast<float>(size));
+    const __m128 vBlend = _mm_set1_ps(blend);
+    const __m128i vMask = _mm_set1_epi32(TableSize ? (TableSize - 1) : -1);
+    for (; i + 4 <= nframes; i += 4) {
+        __m128 pos = _mm_mul_ps(_mm_loadu_ps(phases + i), vSize);
+        __m128i ipos = _mm_cvttps_epi32(pos);
+        __m128 mu = _mm_sub_ps(pos, _mm_cvtepi32_ps(ipos));
+        if (TableSize)
+            ipos = _mm_and_si128(ipos, vMask);
+
+        alignas(16) int32_t j[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(j), ipos);
+
+        // each load gets 2 frames of the pair: lower, upper, lower+1, upper+1
+        __m128 a1 = _mm_loadu_ps(pair + 2 * j[0]);
+        __m128 b1 = _mm_loadu_ps(pair + 2 * j[1]);
+        __m128 a2 = _mm_loadu_ps(pair + 2 * j[2]);
+        __m128 b2 = _mm_loadu_ps(pair + 2 * j[3]);
+        _MM_TRANSPOSE4_PS(a1, b1, a2, b2);
+
+        __m128 a = _mm_add_ps(a1, _mm_mul_ps(mu, _mm_sub_ps(a2, a1)));
+        __m128 b = _mm_add_ps(b1, _mm_mul_ps(mu, _mm_sub_ps(b2, b1)));
+        _mm_storeu_ps(output + i, _mm_add_ps(a, _mm_mul_ps(vBlend, _mm_sub_ps(b, a))));
+    }
+#endif
+
+    for (; i < nframes; ++i) {
+        float pos = phases[i] * size;
+        unsigned j = static_cast<unsigned>(pos);
+        float mu = pos - j;
+        j = wrapTableIndex<TableSize>(j);
+        const float* y = pair + 2 * j;
+        float a = y[0] + mu * (y[2] - y[0]);
+        float b = y[1] + mu * (y[3] - y[1]);
+        output[i] = a + blend * (b - a);
+    }
+}
 
-        return _harmonics[index];
+/**
+ * @brief Select the readers specialized on the table size, which are
+ * instantiated for the powers of two from 256 to 8192, or else the generic
+ * readers.
+ */
+template <unsigned Order>
+static WavetableReader::ReadPlanarFunction selectReadPlanar(unsigned tableSize)
+{
+    switch (tableSize) {
+    case 256:
+        return &readCrossfadePlanar<256, Order>;
+    case 512:
+        return &readCrossfadePlanar<512, Order>;
+    case 1024:
+        return &readCrossfadePlanar<1024, Order>;
+    case 2048:
+        return &readCrossfadePlanar<2048, Order>;
+    case 4096:
+        return &readCrossfadePlanar<4096, Order>;
+    case 8192:
+        return &readCrossfadePlanar<8192, Order>;
+    default:
+        return &readCrossfadePlanar<0, Order>;
+    }
+}
+
+static WavetableReader::ReadInterleavedFunction selectReadInterleaved(unsigned tableSize)
+{
+    switch (tableSize) {
+    case 256:
+        return &readCrossfadeInterleaved<256>;
+    case 512:
+        return &readCrossfadeInterleaved<512>;
+    case 1024:
+        return &readCrossfadeInterleaved<1024>;
+    case 2048:
+        return &readCrossfadeInterleaved<2048>;
+    case 4096:
+        return &readCrossfadeInterleaved<4096>;
+    case 8192:
+        return &readCrossfadeInterleaved<8192>;
+    default:
+        return &readCrossfadeInterleaved<0>;
     }
+}
 
-private:
-    nonstd::span<const std::complex<float>> _harmonics;
-};
+void WavetableReader::setWavetable(const WavetableMulti* wave)
+{
+    _multi = wave;
+    selectReadFunctions();
+}
+
+void WavetableReader::setInterpolation(WavetableInterpolation interpolation)
+{
+    _interpolation = interpolation;
+    selectReadFunctions();
+}
+
+void WavetableReader::selectReadFunctions()
+{
+    const unsigned tableSize = _multi ? _multi->tableSize() : 0;
+
+    switch (_interpolation) {
+    case WavetableInterpolation::Linear:
+        _readPlanar = selectReadPlanar<1>(tableSize);
+        _readInterleaved = selectReadInterleaved(tableSize);
+        break;
+    case WavetableInterpolation::Cubic:
+        // the interleaved pairs have the guards of linear interpolation only
+        _readPlanar = selectReadPlanar<3>(tableSize);
+        _readInterleaved = nullptr;
+        break;
+    }
+}
+
+void WavetableReader::process(float frequency, const float* phases, float* output, unsigned nframes) const
+{
+    const WavetableMulti* multi = _multi;
+    if (!multi) {
+        std::fill(output, output + nframes, 0.0f);
+        return;
+    }
+
+    const unsigned tableSize = multi->tableSize();
+    const WavetableMulti::TablePair pair = multi->getTablePairForFrequency(std::fabs(frequency));
+
+    if (_readInterleaved && multi->hasInterleavedPairs())
+        _readInterleaved(
+            multi->getInterleavedPair(pair.index), pair.blend, tableSize,
+            phases, output, nframes);
+    else
+        _readPlanar(
+            pair.lower.data(), pair.upper.data(), pair.blend, tableSize,
+            phases, output, nframes);
+}
+
+void WavetableReader::processModulated(const float* frequencies, const float* phases, float* output, unsigned nframes) const
+{
+    const WavetableMulti* multi = _multi;
+    if (!multi) {
+        std::fill(output, output + nframes, 0.0f);
+        return;
+    }
+
+    const unsigned tableSize = multi->tableSize();
+    const ReadPlanarFunction readPlanar = _readPlanar;
+
+    for (unsigned i = 0; i < nframes; ++i) {
+        const WavetableMulti::TablePair pair = multi->getTablePairForFrequency(std::fabs(frequencies[i]));
+        readPlanar(
+            pair.lower.data(), pair.upper.data(), pair.blend, tableSize,
+            &phases[i], &output[i], 1);
+    }
+}
 
 //------------------------------------------------------------------------------
-WavetableMulti WavetableMulti::createFromAudioData(
-    nonstd::span<const float> audioData, double amplitude, unsigned tableSize, double refSampleRate)
+void WavetableOscillator::init(double sampleRate)
+{
+    _phasor.init(sampleRate);
+}
+
+void WavetableOscillator::clear()
 {
-    size_t fftSize = audioData.size();
-    size_t specSize = fftSize / 2 + 1;
+    _phasor.clear();
+}
 
-    typedef std::complex<kiss_fft_scalar> cpx;
-    std::unique_ptr<cpx[]> spec { new cpx[specSize] };
+void WavetableOscillator::setWavetable(const WavetableMulti* wave)
+{
+    _reader.setWavetable(wave);
+}
 
-    kiss_fftr_cfg cfg = kiss_fftr_alloc(fftSize, false, nullptr, nullptr);
-    if (!cfg)
-        throw std::bad_alloc();
+void WavetableOscillator::setPhase(float phase)
+{
+    _phasor.setPhase(phase);
+}
 
-    kiss_fftr(cfg, audioData.data(), reinterpret_cast<kiss_fft_cpx*>(spec.get()));
-    kiss_fftr_free(cfg);
+void WavetableOscillator::setInterpolation(WavetableInterpolation interpolation)
+{
+    _reader.setInterpolation(interpolation);
+}
 
-    // scale transform, and normalize amplitude and phase
-    const std::complex<double> k = std::polar(2.0 / fftSize, -M_PI / 2);
-    for (size_t i = 0; i < specSize; ++i)
-        spec[i] *= k;
+void WavetableOscillator::process(float frequency, float* output, unsigned nframes)
+{
+    if (!_reader.getWavetable()) {
+        std::fill(output, output + nframes, 0.0f);
+        return;
+    }
 
-    TabulatedHarmonicProfile hp {
-        nonstd::span<const std::complex<float>> { spec.get(), specSize }
-    };
+    constexpr unsigned bufferSize = 256;
+    float phases[bufferSize];
 
-    return WavetableMulti::createForHarmonicProfile(hp, amplitude, tableSize, refSampleRate);
+    for (unsigned offset = 0; offset < nframes; offset += bufferSize) {
+        unsigned count = std::min(bufferSize, nframes - offset);
+        _phasor.process(frequency, phases, count);
+        _reader.process(frequency, phases, output + offset, count);
+    }
+}
+
+void WavetableOscillator::processModulated(const float* frequencies, float* output, unsigned nframes)
+{
+    if (!_reader.getWavetable()) {
+        std::fill(output, output + nframes, 0.0f);
+        return;
+    }
+
+    constexpr unsigned bufferSize = 256;
+    float phases[bufferSize];
+
+    for (unsigned offset = 0; offset < nframes; offset += bufferSize) {
+        unsigned count = std::min(bufferSize, nframes - offset);
+        _phasor.processModulated(frequencies + offset, phases, count);
+        _reader.processModulated(frequencies + offset, phases, output + offset, count);
+    }
 }
 
 } // namespace sfz
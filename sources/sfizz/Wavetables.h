@@ -5,11 +5,16 @@
 // If not, contact the sfizz maintainers at https://github.com/sfztools/sfizz
 
 #pragma once
+#include "AlignedAllocator.h"
 #include <nonstd/span.hpp>
+#include <algorithm>
 #include <array>
 #include <vector>
+#include <functional>
 #include <memory>
 #include <complex>
+#include <cassert>
+#include <cstdint>
 
 namespace sfz {
 
@@ -36,6 +41,28 @@ public:
     void generate(nonstd::span<float> table, double amplitude, double cutoff) const;
 };
 
+/**
+ * @brief Harmonic profile which takes its values from a table.
+ */
+class TabulatedHarmonicProfile : public HarmonicProfile {
+public:
+    explicit TabulatedHarmonicProfile(nonstd::span<const std::complex<float>> harmonics)
+        : _harmonics(harmonics)
+    {
+    }
+
+    std::complex<double> getHarmonic(size_t index) const override
+    {
+        if (index >= _harmonics.size())
+            return {};
+
+        return _harmonics[index];
+    }
+
+private:
+    nonstd::span<const std::complex<float>> _harmonics;
+};
+
 /**
    A helper to select ranges of a mip-mapped wave, according to the
    frequency of an oscillator.
@@ -87,6 +114,12 @@ public:
     // number of tables in the multisample
     static constexpr unsigned numTables() { return MipmapRange::N; }
 
+    // alignment in bytes of the first element of each table
+    static constexpr unsigned tableAlignment() { return _tableAlignment; }
+
+    // distance in elements between the beginnings of consecutive tables
+    unsigned tableStride() const { return _tableStride; }
+
     // get the N-th table in the multisample
     nonstd::span<const float> getTable(unsigned index) const
     {
@@ -99,40 +132,304 @@ public:
         return getTable(MipmapRange::getIndexForFrequency(freq));
     }
 
+    // a pair of adjacent tables, with the weight of the upper table
+    struct TablePair {
+        unsigned index = 0;
+        nonstd::span<const float> lower;
+        nonstd::span<const float> upper;
+        float blend = 0;
+    };
+
+    // get the tables to crossfade for a given playback frequency, according
+    // to the fractional part of the mipmap index
+    TablePair getTablePairForFrequency(float freq) const
+    {
+        float index = MipmapRange::getIndexForFrequency(freq);
+        TablePair pair;
+        pair.index = static_cast<unsigned>(index);
+        pair.lower = getTable(pair.index);
+        pair.upper = getTable(std::min(pair.index + 1, numTables() - 1));
+        pair.blend = index - pair.index;
+        return pair;
+    }
+
+    // fill the guard elements at the ends of each table with repetitions of
+    // the samples at the other end; the creation does it, and it can be
+    // repeated without effect.
+    void fillExtra();
+
+    // generate the N-th table again according to a harmonic profile, with
+    // its guard elements; the interleaved pairs, if any, are not updated.
+    void regenerateTable(
+        unsigned index, const HarmonicProfile& hp, double amplitude,
+        double refSampleRate = 44100);
+
+    // copy the N-th table, with its guard elements, from another multisample
+    // of the same table size; the interleaved pairs, if any, are not updated.
+    void copyTable(unsigned index, const WavetableMulti& other);
+
+    // whether the multisample has the interleaved layout of table pairs
+    bool hasInterleavedPairs() const { return !_pairData.empty(); }
+
+    // get the number of tables which have storage, from the first
+    unsigned storedTables() const { return _storedTables; }
+
+    // create the interleaved layout, in which the tables N and N+1 are
+    // stored together as frames of 2 elements. It doubles the memory, but a
+    // crossfade between adjacent tables reads 1 region instead of 2.
+    void interleavePairs();
+
+    // get a pointer to the first frame of the interleaved pair (N, N+1),
+    // which has `2 * tableSize()` elements; the last table pairs with itself.
+    const float* getInterleavedPair(unsigned index) const
+    {
+        assert(hasInterleavedPairs());
+        const float* ptr = _pairData.data() + index * _pairStride + _pairLead;
+        assert(reinterpret_cast<std::uintptr_t>(ptr) % _tableAlignment == 0);
+        return ptr;
+    }
+
+    // the stages of the creation of a multisample
+    enum class CreationStage {
+        Synthesis,
+        FillExtra,
+        Done,
+    };
+
+    // receives each stage of a creation as it begins, to measure it
+    typedef std::function<void(CreationStage)> StageCallback;
+
     // create a multisample according to a given harmonic profile
     // the reference sample rate is the minimum value accepted by the DSP
     // system (most defavorable wrt. aliasing)
     static WavetableMulti createForHarmonicProfile(
         const HarmonicProfile& hp, double amplitude,
         unsigned tableSize = 2048,
-        double refSampleRate = 44100);
+        double refSampleRate = 44100,
+        const StageCallback& onStage = nullptr);
 
+    // create a multisample from audio data of any length, which contains
+    // the given number of periods of the waveform
     static WavetableMulti createFromAudioData(
         nonstd::span<const float> audioData, double amplitude,
         unsigned tableSize = 2048,
+        double refSampleRate = 44100,
+        unsigned numCycles = 1);
+
+    // compute the normalized harmonics of audio data, which contains the
+    // given number of periods of a waveform, up to the Nyquist frequency of
+    // the table; it is the spectrum of `tableSize / 2 + 1` bins from which
+    // `createFromAudioData` generates the tables.
+    static std::vector<std::complex<float>> analyzeAudioData(
+        nonstd::span<const float> audioData, unsigned tableSize,
+        unsigned numCycles = 1);
+
+    // receives a table of the multisample, identified by its index
+    typedef std::function<void(unsigned, nonstd::span<const float>)> TableCallback;
+
+    // generate the tables of a multisample one after another, passing each
+    // to the callback; only one table is held in memory at any time.
+    static void generateForHarmonicProfile(
+        const HarmonicProfile& hp, const TableCallback& callback,
+        double amplitude, unsigned tableSize = 2048,
         double refSampleRate = 44100);
 
+    static void generateFromAudioData(
+        nonstd::span<const float> audioData, const TableCallback& callback,
+        double amplitude, unsigned tableSize = 2048,
+        double refSampleRate = 44100, unsigned numCycles = 1);
+
 private:
-    // get a pointer to the beginning of the N-th table
+    // the hybrid multisample keeps the tables of its lower ranges only, and
+    // no one else may truncate a multisample
+    friend class WavetableHybrid;
+
+    // release the storage of the tables from the given index up, and the
+    // interleaved pairs; the released tables must not be read any more.
+    void releaseTables(unsigned firstIndex);
+
+    // generate the N-th table according to a given harmonic profile
+    static void generateTable(
+        const HarmonicProfile& hp, unsigned index, nonstd::span<float> table,
+        double amplitude, double refSampleRate);
+
+    // get a pointer to the beginning of the N-th table, aligned on
+    // `tableAlignment()` bytes
     const float* getTablePointer(unsigned index) const
     {
-        return _multiData.data() + index * (_tableSize + 2 * _tableExtra) + _tableExtra;
+        assert(index < _storedTables);
+        const float* ptr = _multiData.data() + index * _tableStride + _tableLead;
+        assert(reinterpret_cast<std::uintptr_t>(ptr) % _tableAlignment == 0);
+        return ptr;
     }
 
     // allocate the internal data for tables of the given size
     void allocateStorage(unsigned tableSize);
 
-    // fill extra data at table ends with repetitions of the first samples
-    void fillExtra();
+    // fill the guard elements of the N-th table
+    void fillExtra(unsigned index);
 
     // length of each individual table of the multisample
     unsigned _tableSize = 0;
 
+    // number of tables which have storage, from the first
+    unsigned _storedTables = 0;
+
     // number X of extra elements, for safe interpolations up to X-th order.
     static constexpr unsigned _tableExtra = 4;
 
-    // internal storage, having `multiSize` rows and `tableSize` columns.
-    std::vector<float> _multiData;
+    // alignment of the tables, which is the size of a cache line.
+    static constexpr unsigned _tableAlignment = 64;
+
+    // number of elements which fit in the alignment boundary
+    static constexpr unsigned _alignedElements = _tableAlignment / sizeof(float);
+
+    // number of elements preceding each table, which contains the extra
+    // elements of the left side, rounded up to preserve the alignment.
+    static constexpr unsigned _tableLead =
+        (_tableExtra + _alignedElements - 1) / _alignedElements * _alignedElements;
+
+    // distance between consecutive tables, a multiple of the cache line, so
+    // that no two tables share a line.
+    unsigned _tableStride = 0;
+
+    // number of elements preceding each interleaved pair
+    static constexpr unsigned _pairLead =
+        (2 * _tableExtra + _alignedElements - 1) / _alignedElements * _alignedElements;
+
+    // distance between consecutive interleaved pairs
+    unsigned _pairStride = 0;
+
+    typedef std::vector<float, AlignedAllocator<float, _tableAlignment>> AlignedVector;
+
+    // internal storage, having `multiSize` rows and `tableStride` columns.
+    AlignedVector _multiData;
+
+    // interleaved storage, having `multiSize` rows and `pairStride` columns.
+    AlignedVector _pairData;
+};
+
+/**
+   The phase accumulator of an oscillator, which produces phases in the range
+   [0:1). A single phasor can drive several readers at the same frequency.
+ */
+class WavetablePhasor {
+public:
+    // initialize with the given sample rate
+    void init(double sampleRate);
+
+    // reset to the initial phase
+    void clear();
+
+    // set the current phase, in the range [0:1)
+    void setPhase(float phase);
+
+    // get the current phase
+    float phase() const { return _phase; }
+
+    // compute a block of phases at a constant frequency
+    void process(float frequency, float* phases, unsigned nframes);
+
+    // compute a block of phases with a frequency for each frame
+    void processModulated(const float* frequencies, float* phases, unsigned nframes);
+
+private:
+    // advance the phase and store the phase of each frame in the buffer
+    void computePhases(float phaseInc, float* phases, unsigned nframes);
+
+    float _phase = 0.0f;
+    float _sampleInterval = 0.0f;
+};
+
+/**
+   The interpolation of the tables, by the order of its polynomial.
+ */
+enum class WavetableInterpolation {
+    Linear = 1,
+    // cubic Hermite, using the guard elements around the tables
+    Cubic = 3,
+};
+
+/**
+   A reader of a multisample at the phases given by a phasor, with a crossfade
+   between the two tables adjacent to the playback frequency. The reader has
+   no state besides the multisample and the interpolation.
+
+   The reading is specialized at compile time on the interpolation and on the
+   table sizes which are powers of two from 256 to 8192; the specialization is
+   selected when the multisample or the interpolation changes.
+ */
+class WavetableReader {
+public:
+    WavetableReader() { selectReadFunctions(); }
+
+    // set the multisample to play; it must outlive the reader
+    void setWavetable(const WavetableMulti* wave);
+
+    // get the multisample to play
+    const WavetableMulti* getWavetable() const { return _multi; }
+
+    // set the interpolation of the tables (default: linear)
+    void setInterpolation(WavetableInterpolation interpolation);
+
+    // get the interpolation of the tables
+    WavetableInterpolation interpolation() const { return _interpolation; }
+
+    // read a block of phases at a constant frequency
+    void process(float frequency, const float* phases, float* output, unsigned nframes) const;
+
+    // read a block of phases with a frequency for each frame
+    void processModulated(const float* frequencies, const float* phases, float* output, unsigned nframes) const;
+
+    // functions which read and crossfade a pair of tables
+    typedef void (*ReadPlanarFunction)(
+        const float* lower, const float* upper, float blend, unsigned tableSize,
+        const float* phases, float* output, unsigned nframes);
+    typedef void (*ReadInterleavedFunction)(
+        const float* pair, float blend, unsigned tableSize,
+        const float* phases, float* output, unsigned nframes);
+
+private:
+    void selectReadFunctions();
+
+    const WavetableMulti* _multi = nullptr;
+    WavetableInterpolation _interpolation = WavetableInterpolation::Linear;
+    ReadPlanarFunction _readPlanar = nullptr;
+    // a function for the interleaved pairs, or null if they are not supported
+    ReadInterleavedFunction _readInterleaved = nullptr;
+};
+
+/**
+   An oscillator which reads a multisample, with a crossfade between the two
+   tables adjacent to the playback frequency, and interpolation.
+   It is a phasor which drives a reader.
+ */
+class WavetableOscillator {
+public:
+    // initialize with the given sample rate
+    void init(double sampleRate);
+
+    // reset the oscillator to the initial phase
+    void clear();
+
+    // set the multisample to play; it must outlive the oscillator
+    void setWavetable(const WavetableMulti* wave);
+
+    // set the current phase, in the range [0:1)
+    void setPhase(float phase);
+
+    // set the interpolation of the tables (default: linear)
+    void setInterpolation(WavetableInterpolation interpolation);
+
+    // compute a block of output at a constant frequency
+    void process(float frequency, float* output, unsigned nframes);
+
+    // compute a block of output with a frequency for each frame
+    void processModulated(const float* frequencies, float* output, unsigned nframes);
+
+private:
+    WavetablePhasor _phasor;
+    WavetableReader _reader;
 };
 
 } // namespace sfz
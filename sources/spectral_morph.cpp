@@ -0,0 +1,58 @@
+#include "spectral_morph.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+// the magnitude relative to the largest harmonic below which the phase is
+// noise; such harmonics take the phase of the previous one
+static constexpr float silent_harmonic = 1e-6f;
+
+static void unwrap_spectrum(nonstd::span<const std::complex<float>> spectrum,
+                            std::vector<float> &magnitudes, std::vector<float> &phases)
+{
+    const size_t size = spectrum.size();
+    magnitudes.resize(size);
+    phases.resize(size);
+
+    float max_magnitude = 0;
+    for (size_t k = 0; k < size; ++k) {
+        magnitudes[k] = std::abs(spectrum[k]);
+        max_magnitude = std::max(max_magnitude, magnitudes[k]);
+    }
+
+    float previous = 0;
+    for (size_t k = 0; k < size; ++k) {
+        if (magnitudes[k] <= silent_harmonic * max_magnitude) {
+            phases[k] = previous;
+            continue;
+        }
+        // the nearest value of the phase to the previous harmonic
+        float phase = std::arg(spectrum[k]);
+        phase += 2 * (float)M_PI * std::round((previous - phase) / (2 * (float)M_PI));
+        phases[k] = previous = phase;
+    }
+}
+
+SpectralMorph::SpectralMorph(nonstd::span<const std::complex<float>> first, nonstd::span<const std::complex<float>> last)
+{
+    if (first.size() != last.size())
+        throw std::invalid_argument("The spectra of a morph must have the same size");
+
+    unwrap_spectrum(first, magnitudes_[0], phases_[0]);
+    unwrap_spectrum(last, magnitudes_[1], phases_[1]);
+}
+
+std::vector<std::complex<float>> SpectralMorph::interpolate(float position) const
+{
+    const size_t size = this->size();
+    const float a = 1 - position;
+    const float b = position;
+
+    std::vector<std::complex<float>> spectrum(size);
+    for (size_t k = 0; k < size; ++k) {
+        float magnitude = a * magnitudes_[0][k] + b * magnitudes_[1][k];
+        float phase = a * phases_[0][k] + b * phases_[1][k];
+        spectrum[k] = std::polar(magnitude, phase);
+    }
+    return spectrum;
+}
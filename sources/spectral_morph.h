@@ -0,0 +1,22 @@
+#pragma once
+#include <nonstd/span.hpp>
+#include <complex>
+#include <vector>
+
+// a morph between two spectra of equal size, which interpolates the
+// magnitudes and the phases of the harmonics; the phases are unwrapped along
+// the harmonics, so that a delay between the waveforms morphs as a delay
+// instead of cancelling.
+class SpectralMorph {
+public:
+    SpectralMorph(nonstd::span<const std::complex<float>> first, nonstd::span<const std::complex<float>> last);
+
+    size_t size() const { return magnitudes_[0].size(); }
+
+    // get the spectrum at a position from 0, the first, to 1, the last
+    std::vector<std::complex<float>> interpolate(float position) const;
+
+private:
+    std::vector<float> magnitudes_[2];
+    std::vector<float> phases_[2];
+};
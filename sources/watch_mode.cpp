@@ -0,0 +1,161 @@
+#include "watch_mode.h"
+#include <nonstd/scope.hpp>
+#include <chrono>
+#include <map>
+#include <set>
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+struct WatchedDirectory {
+    std::string path;
+    // whether every sound file of the directory is an input
+    bool all_waves = false;
+    // the names of the inputs in the directory, otherwise
+    std::set<std::string> files;
+};
+
+} // namespace
+
+static std::string parent_directory(const std::string &path)
+{
+    size_t pos = path.rfind('/');
+    if (pos == std::string::npos)
+        return ".";
+    if (pos == 0)
+        return "/";
+    return path.substr(0, pos);
+}
+
+static std::string base_name(const std::string &path)
+{
+    size_t pos = path.rfind('/');
+    return (pos == std::string::npos) ? path : path.substr(pos + 1);
+}
+
+int run_watch_mode(const std::vector<std::string> &inputs, const char *output,
+                   const ConversionOptions &options, unsigned debounce_ms,
+                   const StatsFormat *stats_format)
+{
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot initialize the file watcher.\n");
+        return 1;
+    }
+    auto fd_cleanup = nonstd::make_scope_exit([fd]() { close(fd); });
+
+    // editors often save by renaming a temporary file over the original, so
+    // watch the directories rather than the files
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+    std::map<int, WatchedDirectory> watches;
+    for (const std::string &input : inputs) {
+        bool input_is_dir = is_directory(input);
+        std::string dir_path = input_is_dir ? input : parent_directory(input);
+
+        int wd = inotify_add_watch(fd, dir_path.c_str(), mask);
+        if (wd == -1) {
+            fprintf(stderr, "Cannot watch the directory: %s\n", dir_path.c_str());
+            return 1;
+        }
+
+        WatchedDirectory &dir = watches[wd];
+        dir.path = dir_path;
+        if (input_is_dir)
+            dir.all_waves = true;
+        else
+            dir.files.insert(base_name(input));
+    }
+
+    const bool batch = is_batch_conversion(inputs);
+    const clock_type::duration debounce = std::chrono::milliseconds(debounce_ms);
+
+    // the inputs which changed, with the time after which to regenerate
+    std::map<std::string, clock_type::time_point> pending;
+
+    fprintf(stderr, "Watching for changes.\n");
+
+    for (;;) {
+        int timeout = -1;
+        if (!pending.empty()) {
+            clock_type::time_point next = pending.begin()->second;
+            for (const auto &item : pending)
+                next = std::min(next, item.second);
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(next - clock_type::now());
+            timeout = (int)std::max<long long>(0, remaining.count() + 1);
+        }
+
+        pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        int n = poll(&pfd, 1, timeout);
+        if (n == -1 && errno != EINTR) {
+            fprintf(stderr, "Cannot wait for changes.\n");
+            return 1;
+        }
+
+        if (n > 0) {
+            alignas(inotify_event) char buffer[4096];
+            ssize_t count;
+            while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+                for (char *p = buffer; p < buffer + count;) {
+                    const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+                    p += sizeof(inotify_event) + event->len;
+
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        // events were lost, so regenerate everything
+                        std::vector<ConversionJob> jobs;
+                        if (collect_conversion_jobs(inputs, output, options.format, jobs)) {
+                            for (const ConversionJob &job : jobs)
+                                pending[job.input_path] = clock_type::now() + debounce;
+                        }
+                        continue;
+                    }
+
+                    auto it = watches.find(event->wd);
+                    if (it == watches.end() || event->len == 0)
+                        continue;
+
+                    const WatchedDirectory &dir = it->second;
+                    std::string name = event->name;
+                    bool relevant = dir.all_waves ? is_wave_file_name(name) : (dir.files.count(name) > 0);
+                    if (relevant)
+                        pending[dir.path + '/' + name] = clock_type::now() + debounce;
+                }
+            }
+        }
+
+        // regenerate the inputs which have been quiet for the debounce time
+        clock_type::time_point now = clock_type::now();
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it->second > now) {
+                ++it;
+                continue;
+            }
+
+            ConversionJob job;
+            job.input_path = it->first;
+            job.output_path = batch ? batch_output_path(it->first, output, options.format) : output;
+            it = pending.erase(it);
+
+            clock_type::time_point start = clock_type::now();
+            ConversionStats stats;
+            int ret = run_conversion_job(job, options, stats_format ? &stats : nullptr);
+            double ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+
+            if (ret == 0) {
+                fprintf(stderr, "Regenerated %s (%.1f ms)\n", job.output_path.c_str(), ms);
+                if (stats_format)
+                    print_conversion_stats(stderr, *stats_format, job.input_path.c_str(), stats);
+            }
+            else
+                fprintf(stderr, "Cannot convert: %s\n", job.input_path.c_str());
+        }
+    }
+}
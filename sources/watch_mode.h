@@ -0,0 +1,11 @@
+#pragma once
+#include "conversion.h"
+#include <string>
+#include <vector>
+
+// regenerate the outputs whenever their inputs change, until interrupted;
+// the first conversion of all jobs must have been done before; if a stats
+// format is given, the stats of each regeneration are printed in it
+int run_watch_mode(const std::vector<std::string> &inputs, const char *output,
+                   const ConversionOptions &options, unsigned debounce_ms,
+                   const StatsFormat *stats_format = nullptr);